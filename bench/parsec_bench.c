@@ -0,0 +1,321 @@
+//===--------------------------------------------------------------------------------------------===
+// parsec_bench.c - Benchmarks for the ParseC lexer and conversion functions
+// This source is part of ParseC
+//
+// Copyright (c) 2018 Amy Parent <amy@amyparent.com>
+// Licensed under the MIT License
+// =^•.•^=
+//===--------------------------------------------------------------------------------------------===
+#define _POSIX_C_SOURCE 200809L
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <parsec/parsec.h>
+
+// Usage:
+//      parsec_bench [--size MB] [--reps N] [--out FILE]
+//      parsec_bench --compare BASELINE CANDIDATE
+//
+// The first form generates synthetic corpora, runs each benchmark [reps] times and reports the
+// median. With --out, the results are also written to FILE in a plain format that --compare
+// reads back, to compare two builds run on the same machine.
+
+#define MAX_RESULTS 64
+
+typedef struct {
+    char        name[64];
+    double      ns_per_item;
+    double      mb_per_s;
+    double      items_per_s;
+} bench_result;
+
+typedef struct {
+    const char* name;
+    void        (*generate)(char* buffer, uint64_t size);
+} bench_corpus;
+
+// MARK: - Corpus generators
+
+// Deterministic, so every build lexes the very same input.
+static uint64_t rng_state = 0x9e3779b97f4a7c15;
+
+static uint32_t rng(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return (uint32_t)(rng_state >> 16);
+}
+
+// Appends [str] to [ptr] if it fits before [end], and returns the new write position.
+static char* emit(char* ptr, const char* end, const char* str) {
+    uint64_t length = strlen(str);
+    if(ptr + length > end) return ptr;
+    memcpy(ptr, str, length);
+    return ptr + length;
+}
+
+// Pads the rest of the buffer with spaces, ending on a line return.
+static void finish(char* ptr, char* end) {
+    while(ptr < end) *ptr++ = ' ';
+    end[-1] = '\n';
+}
+
+static void generate_numeric(char* buffer, uint64_t size) {
+    char* ptr = buffer;
+    char* end = buffer + size - 1;
+    char field[64];
+    while(end - ptr > 128) {
+        ptr = emit(ptr, end, "PT ");
+        snprintf(field, sizeof(field), "%u ", rng());
+        ptr = emit(ptr, end, field);
+        for(int i = 0; i < 3; ++i) {
+            snprintf(field, sizeof(field), "%.*f ", (int)(rng() % 10), (rng() % 2000000) / 1000.0 - 1000.0);
+            ptr = emit(ptr, end, field);
+        }
+        snprintf(field, sizeof(field), "%.6e\n", (double)rng() * 1e-5);
+        ptr = emit(ptr, end, field);
+    }
+    finish(ptr, buffer + size);
+}
+
+static void generate_comments(char* buffer, uint64_t size) {
+    static const char* words[] = { "the", "quick", "brown", "fox", "jumps", "over", "lazy", "dog" };
+    char* ptr = buffer;
+    char* end = buffer + size - 1;
+    while(end - ptr > 256) {
+        if(rng() % 4 == 0) {
+            ptr = emit(ptr, end, "KEY 12 3.5\n");
+            continue;
+        }
+        ptr = emit(ptr, end, "# ");
+        int count = 4 + rng() % 20;
+        for(int i = 0; i < count; ++i) {
+            ptr = emit(ptr, end, words[rng() % 8]);
+            ptr = emit(ptr, end, " ");
+        }
+        ptr = emit(ptr, end, "\n");
+    }
+    finish(ptr, buffer + size);
+}
+
+static void generate_identifiers(char* buffer, uint64_t size) {
+    static const char* words[] = { "école", "naïve", "größe", "δέλτα", "обмен", "数据", "km_per_h", "façade" };
+    char* ptr = buffer;
+    char* end = buffer + size - 1;
+    while(end - ptr > 256) {
+        int count = 2 + rng() % 6;
+        for(int i = 0; i < count; ++i) {
+            ptr = emit(ptr, end, words[rng() % 8]);
+            ptr = emit(ptr, end, " ");
+        }
+        ptr = emit(ptr, end, "\n");
+    }
+    finish(ptr, buffer + size);
+}
+
+static void generate_strings(char* buffer, uint64_t size) {
+    char* ptr = buffer;
+    char* end = buffer + size - 1;
+    while(end - ptr > 512) {
+        ptr = emit(ptr, end, "NAME '");
+        int length = 32 + rng() % 256;
+        for(int i = 0; i < length; ++i) *ptr++ = i % 7 == 0 ? ' ' : 'a' + rng() % 26;
+        ptr = emit(ptr, end, "'\n");
+    }
+    finish(ptr, buffer + size);
+}
+
+static const bench_corpus corpora[] = {
+    { "numeric",        generate_numeric },
+    { "comments",       generate_comments },
+    { "identifiers",    generate_identifiers },
+    { "strings",        generate_strings },
+};
+
+// MARK: - Timing
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+static int compare_doubles(const void* a, const void* b) {
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+static double median(double* samples, int count) {
+    qsort(samples, count, sizeof(double), compare_doubles);
+    return samples[count / 2];
+}
+
+static bench_result results[MAX_RESULTS];
+static int result_count = 0;
+
+static void report(const char* corpus, const char* bench, double ns, uint64_t bytes, uint64_t items) {
+    if(result_count == MAX_RESULTS || !items) return;
+    bench_result* result = &results[result_count++];
+    snprintf(result->name, sizeof(result->name), "%s/%s", corpus, bench);
+    result->ns_per_item = ns / (double)items;
+    result->mb_per_s = (double)bytes / (1024.0 * 1024.0) / (ns * 1e-9);
+    result->items_per_s = (double)items / (ns * 1e-9);
+    printf("%-28s %10.1f MB/s %10.2f Mitems/s %8.2f ns/item\n",
+           result->name, result->mb_per_s, result->items_per_s / 1e6, result->ns_per_item);
+}
+
+// Keeps the compiler from optimising conversions away.
+static volatile double sink;
+
+// MARK: - Benchmarks
+
+static void run_corpus(const bench_corpus* corpus, uint64_t size, int reps) {
+    char* buffer = malloc(size);
+    uint64_t capacity = size / 2 + 16;
+    parsec_token* tokens = malloc(capacity * sizeof(parsec_token));
+    double* samples = malloc(reps * sizeof(double));
+    if(!buffer || !tokens || !samples) {
+        fprintf(stderr, "parsec_bench: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+    corpus->generate(buffer, size);
+    
+    // Lexing. The first run warms the caches up, and checks the corpus actually lexes.
+    parsec parser;
+    parsec_result count = 0;
+    for(int i = -1; i < reps; ++i) {
+        parsec_init(&parser, buffer, size, '#');
+        double start = now_ns();
+        count = parsec_lex(&parser, tokens, capacity);
+        double elapsed = now_ns() - start;
+        if(count < 0) {
+            fprintf(stderr, "parsec_bench: %s corpus failed to lex (%d)\n", corpus->name, count);
+            exit(EXIT_FAILURE);
+        }
+        if(i >= 0) samples[i] = elapsed;
+    }
+    report(corpus->name, "parsec_lex", median(samples, reps), size, count);
+    
+    // Conversions, over the tokens we just lexed.
+    uint64_t float_bytes = 0, float_count = 0, int_bytes = 0, int_count = 0;
+    for(parsec_result i = 0; i < count; ++i) {
+        if(tokens[i].kind == PARSEC_TOKEN_FLOAT) {
+            float_bytes += tokens[i].length;
+            float_count += 1;
+        } else if(tokens[i].kind == PARSEC_TOKEN_INT) {
+            int_bytes += tokens[i].length;
+            int_count += 1;
+        }
+    }
+    
+    for(int i = -1; i < reps && float_count; ++i) {
+        double total = 0.0;
+        double start = now_ns();
+        for(parsec_result t = 0; t < count; ++t) {
+            if(tokens[t].kind != PARSEC_TOKEN_FLOAT) continue;
+            total += parsec_str_double(tokens[t].start, tokens[t].length);
+        }
+        double elapsed = now_ns() - start;
+        sink = total;
+        if(i >= 0) samples[i] = elapsed;
+    }
+    if(float_count) report(corpus->name, "parsec_str_double", median(samples, reps), float_bytes, float_count);
+    
+    for(int i = -1; i < reps && int_count; ++i) {
+        int64_t total = 0;
+        double start = now_ns();
+        for(parsec_result t = 0; t < count; ++t) {
+            if(tokens[t].kind != PARSEC_TOKEN_INT) continue;
+            total += parsec_str_int(tokens[t].start, tokens[t].length);
+        }
+        double elapsed = now_ns() - start;
+        sink = (double)total;
+        if(i >= 0) samples[i] = elapsed;
+    }
+    if(int_count) report(corpus->name, "parsec_str_int", median(samples, reps), int_bytes, int_count);
+    
+    free(samples);
+    free(tokens);
+    free(buffer);
+}
+
+// MARK: - Result files
+
+static bool write_results(const char* path) {
+    FILE* file = fopen(path, "w");
+    if(!file) return false;
+    for(int i = 0; i < result_count; ++i) {
+        fprintf(file, "%s %.4f %.4f %.4f\n", results[i].name, results[i].ns_per_item,
+                results[i].mb_per_s, results[i].items_per_s);
+    }
+    return fclose(file) == 0;
+}
+
+static int read_results(const char* path, bench_result* out) {
+    FILE* file = fopen(path, "r");
+    if(!file) return -1;
+    int count = 0;
+    while(count < MAX_RESULTS && fscanf(file, "%63s %lf %lf %lf", out[count].name,
+          &out[count].ns_per_item, &out[count].mb_per_s, &out[count].items_per_s) == 4) {
+        count += 1;
+    }
+    fclose(file);
+    return count;
+}
+
+static int compare(const char* baseline_path, const char* candidate_path) {
+    static bench_result baseline[MAX_RESULTS], candidate[MAX_RESULTS];
+    int baseline_count = read_results(baseline_path, baseline);
+    int candidate_count = read_results(candidate_path, candidate);
+    if(baseline_count < 0 || candidate_count < 0) {
+        fprintf(stderr, "parsec_bench: can't read %s\n", baseline_count < 0 ? baseline_path : candidate_path);
+        return EXIT_FAILURE;
+    }
+    
+    printf("%-28s %12s %12s %9s\n", "benchmark", "base ns/item", "new ns/item", "speedup");
+    for(int i = 0; i < candidate_count; ++i) {
+        for(int j = 0; j < baseline_count; ++j) {
+            if(strcmp(candidate[i].name, baseline[j].name) != 0) continue;
+            printf("%-28s %12.2f %12.2f %8.2fx\n", candidate[i].name, baseline[j].ns_per_item,
+                   candidate[i].ns_per_item, baseline[j].ns_per_item / candidate[i].ns_per_item);
+        }
+    }
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, const char** argv) {
+    uint64_t size = 32;
+    int reps = 9;
+    const char* out = NULL;
+    
+    for(int i = 1; i < argc; ++i) {
+        if(strcmp(argv[i], "--compare") == 0 && i + 2 < argc) return compare(argv[i + 1], argv[i + 2]);
+        else if(strcmp(argv[i], "--size") == 0 && i + 1 < argc) size = strtoull(argv[++i], NULL, 10);
+        else if(strcmp(argv[i], "--reps") == 0 && i + 1 < argc) reps = atoi(argv[++i]);
+        else if(strcmp(argv[i], "--out") == 0 && i + 1 < argc) out = argv[++i];
+        else {
+            fprintf(stderr, "usage: %s [--size MB] [--reps N] [--out FILE]\n", argv[0]);
+            fprintf(stderr, "       %s --compare BASELINE CANDIDATE\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if(size < 1) size = 1;
+    if(reps < 1) reps = 1;
+
+#ifndef __OPTIMIZE__
+    fprintf(stderr, "parsec_bench: warning: built without optimisations, use a Release build\n");
+#endif
+
+    for(uint64_t i = 0; i < sizeof(corpora) / sizeof(corpora[0]); ++i) {
+        run_corpus(&corpora[i], size * 1024 * 1024, reps);
+    }
+    
+    if(out && !write_results(out)) {
+        fprintf(stderr, "parsec_bench: can't write %s\n", out);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
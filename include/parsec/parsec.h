@@ -10,16 +10,37 @@
 #ifndef _PARSEC_H_
 #define _PARSEC_H_
 
+#include <stdbool.h>
 #include <stdint.h>
 
-typedef struct  parsec_token_s  parsec_token;
-typedef struct  parsec_s        parsec;
-typedef enum    parsec_result_e parsec_result;
-typedef enum    parsec_kind_e   parsec_kind;
+#ifdef __cplusplus
+extern "C" {
+#endif
 
-typedef uint32_t                parsec_idx;
+typedef struct  parsec_token_s          parsec_token;
+typedef struct  parsec_s                parsec;
+typedef struct  parsec_packed_token_s   parsec_packed_token;
+typedef struct  parsec_token_soa_s      parsec_token_soa;
+typedef struct  parsec_segment_s        parsec_segment;
+typedef struct  parsec_segments_s       parsec_segments;
+typedef struct  parsec_stream_s         parsec_stream;
+typedef struct  parsec_reader_s         parsec_reader;
+typedef struct  parsec_batch_item_s     parsec_batch_item;
+typedef struct  parsec_line_index_s     parsec_line_index;
+typedef struct  parsec_token_cache_s    parsec_token_cache;
+typedef struct  parsec_keywords_s       parsec_keywords;
+typedef struct  parsec_edit_s           parsec_edit;
+typedef struct  parsec_allocator_s      parsec_allocator;
+typedef struct  parsec_arena_s          parsec_arena;
+typedef struct  parsec_arena_block_s    parsec_arena_block;
+typedef struct  parsec_column_s         parsec_column;
+typedef struct  parsec_schema_s         parsec_schema;
+typedef union   parsec_value_u          parsec_value;
+typedef struct  parsec_stats_s          parsec_stats;
 
-enum parsec_kind_e {
+typedef uint32_t                        parsec_idx;
+
+typedef enum parsec_kind_e {
     PARSEC_TOKEN_INVALID    = -1,
     PARSEC_TOKEN_STRING,
     PARSEC_TOKEN_KEY,
@@ -28,18 +49,141 @@ enum parsec_kind_e {
     PARSEC_TOKEN_COMMENT,
     PARSEC_TOKEN_NEWLINE,
     PARSEC_TOKEN_MARKER,
-};
+} parsec_kind;
+
+#define PARSEC_KIND_COUNT       8       // including PARSEC_TOKEN_INVALID
+
+// Number syntax. Both dialects accept the same numbers, except for exponent markers.
+typedef enum parsec_dialect_e {
+    PARSEC_DIALECT_DEFAULT,     // 'e', 'E', 'd' or 'D', as in Fortran (1.5d3)
+    PARSEC_DIALECT_C,           // 'e' or 'E' only
+} parsec_dialect;
+
+#define PARSEC_DIALECT_COUNT    2
 
-enum parsec_result_e {
+typedef enum parsec_result_e {
     PARSEC_SUCCESS          =  0,
     PARSEC_NOMEM            = -1,
-    PARSEC_INVALID          = -2
-};
+    PARSEC_INVALID          = -2,
+    PARSEC_NOALLOC          = -3,
+    PARSEC_NOFILE           = -4,
+    PARSEC_OVERFLOW         = -5,
+} parsec_result;
+
+#define PARSEC_KEYWORD_UNKNOWN  (-1)
 
+// [keyword] is the index of a KEY token in the parser's keyword table, or PARSEC_KEYWORD_UNKNOWN
+// (always, for other kinds of tokens and when no table is set).
 struct parsec_token_s {
     parsec_kind kind;
     const char* start;
     parsec_idx  length;
+    int32_t     keyword;
+};
+
+// The value of an INT ([integer]) or FLOAT ([real]) token, computed while lexing it.
+union parsec_value_u {
+    int64_t     integer;
+    double      real;
+};
+
+typedef enum parsec_field_e {
+    PARSEC_FIELD_INT,       // int64_t column
+    PARSEC_FIELD_FLOAT,     // double column, also accepts INT tokens (of any size)
+    PARSEC_FIELD_STRING,    // parsec_token column
+    PARSEC_FIELD_KEY,       // parsec_token column
+} parsec_field;
+
+struct parsec_column_s {
+    parsec_field    type;
+    void*           data;
+};
+
+// The layout of records that start with [keyword]: each following token on the line goes into
+// the next of [columns], at index [rows]. [errors] (which can be NULL) holds one bit per row, set
+// when the row didn't match the schema (including INT fields that don't fit in an int64_t): that
+// row's values are then unspecified.
+struct parsec_schema_s {
+    const char*     keyword;
+    parsec_column*  columns;
+    uint32_t        column_count;
+    uint64_t        capacity;
+    uint64_t        rows;
+    uint8_t*        errors;
+};
+
+// A fixed set of keywords, with a perfect hash found when the table is created, so that looking up
+// a key is a single hash and comparison.
+struct parsec_keywords_s {
+    const char* const*  words;
+    parsec_idx*         lengths;
+    int32_t*            slots;
+    uint32_t            mask;
+    uint32_t            seed;
+    uint32_t            count;
+};
+
+// Compact, 8-byte token: the offset of the token from [parsec.data], its length in the low 24
+// bits of [info] and its kind in the high 8 bits. Use the parsec_packed_* accessors to read it.
+struct parsec_packed_token_s {
+    uint32_t    offset;
+    uint32_t    info;
+};
+
+#define PARSEC_PACKED_MAX_LENGTH    0x00ffffff
+
+// Packed tokens for inputs of any size. The input is cut at line boundaries into segments of at
+// most PARSEC_SEGMENT_MAX bytes, and the offset of each token is relative to its segment's [base]
+// (itself an offset from [parsec.data]), so tokens stay 8 bytes however big the input is. Segments
+// share nothing: each can be lexed, and its tokens used, on its own. [result] is the outcome of
+// lexing the segment, and [count] the number of tokens before the first one that failed.
+struct parsec_segment_s {
+    uint64_t                base;
+    uint64_t                length;
+    parsec_packed_token*    tokens;
+    uint64_t                count;
+    uint64_t                capacity;
+    parsec_result           result;
+};
+
+struct parsec_segments_s {
+    parsec_segment*     segments;
+    uint64_t            count;
+};
+
+#define PARSEC_SEGMENT_MAX          (1ull << 32)
+
+// Struct-of-arrays token storage: three caller-allocated arrays, indexed by token.
+struct parsec_token_soa_s {
+    int8_t*     kinds;
+    uint32_t*   offsets;
+    parsec_idx* lengths;
+};
+
+// Lexer statistics. Every parser has them, so its layout doesn't depend on how the library was
+// built, but they are only counted when it's built with PARSEC_ENABLE_STATS (and stay at zero
+// otherwise). Token counts and bytes are indexed by [kind + 1], so invalid tokens go in the first
+// slot. [non_ascii] counts the multibyte characters in everything lexed, comments included.
+// [calls] counts every call to each hot routine, but only one in PARSEC_STATS_SAMPLE of them is
+// timed: [cycles] (TSC ticks on x86, nanoseconds elsewhere) adds up over [samples] timed calls.
+typedef enum parsec_stat_section_e {
+    PARSEC_STAT_NUMBER,
+    PARSEC_STAT_KEY,
+    PARSEC_STAT_STRING,
+    PARSEC_STAT_WHITESPACE,
+    PARSEC_STAT_LINE,
+    PARSEC_STAT_SECTION_COUNT
+} parsec_stat_section;
+
+#define PARSEC_STATS_SAMPLE     64
+
+struct parsec_stats_s {
+    uint64_t    tokens[PARSEC_KIND_COUNT];
+    uint64_t    bytes[PARSEC_KIND_COUNT];
+    uint64_t    non_ascii;
+    uint64_t    calls[PARSEC_STAT_SECTION_COUNT];
+    uint64_t    cycles[PARSEC_STAT_SECTION_COUNT];
+    uint64_t    samples[PARSEC_STAT_SECTION_COUNT];
 };
 
 struct parsec_s {
@@ -48,13 +192,274 @@ struct parsec_s {
     const char* end;
     const char* head;
     parsec_idx  next_token;
+    const parsec_keywords* keywords;
+    parsec_dialect dialect;
+    bool        validated;  // the input is known to be valid UTF-8, so it's decoded unchecked
+    parsec_stats stats;
+};
+
+// Token storage that grows as needed, in blocks allocated through [allocator]. Tokens are never
+// moved once written, so they stay valid until the arena is released.
+struct parsec_allocator_s {
+    void*       (*alloc)(uint64_t size, void* user);
+    void        (*free)(void* ptr, uint64_t size, void* user);
+    void*       user;
+};
+
+struct parsec_arena_block_s {
+    parsec_arena_block* next;
+    parsec_token*       tokens;
+    uint64_t            count;
+    uint64_t            capacity;
+};
+
+struct parsec_arena_s {
+    parsec_allocator    allocator;
+    parsec_arena_block* first;
+    parsec_arena_block* last;
+    uint64_t            count;
 };
 
+// Byte offset of the start of every line of a source, used to lex any range of lines on its own
+// and to map tokens back to lines and columns. [length] and [hash] (of samples of it) identify the
+// source.
+struct parsec_line_index_s {
+    uint64_t*   lines;
+    uint64_t    count;
+    uint64_t    length;
+    uint64_t    hash;
+};
+
+// Tokens (and optionally values) loaded from an on-disk cache. Both arrays are read straight from
+// a read-only mapping of the cache file, and [values] is NULL if the cache was saved without them.
+struct parsec_token_cache_s {
+    const parsec_packed_token*  tokens;
+    const parsec_value*         values;
+    uint64_t                    count;
+    void*                       mapping;
+    uint64_t                    size;
+};
+
+// An edit of a source: [removed] bytes at [offset] were replaced by [inserted] new bytes.
+struct parsec_edit_s {
+    uint64_t    offset;
+    uint64_t    removed;
+    uint64_t    inserted;
+};
 
+// A stream lexes input that arrives in chunks (from a pipe or a socket) without ever holding the
+// whole of it in memory. Only complete lines are lexed, and the trailing partial line of a chunk
+// is kept in [buffer] until the rest of it arrives.
+struct parsec_stream_s {
+    parsec      parser;
+    char*       buffer;
+    uint64_t    size;
+    uint64_t    capacity;
+};
+
+// Initialises [status] to lex [source]. The input is checked for valid UTF-8 once, up front (see
+// [validated]): invalid input can still be lexed, but multibyte characters are then checked
+// every time they are decoded.
 void parsec_init(parsec* status, const char* source, uint64_t length, char comment_char);
+bool parsec_utf8_valid(const char* data, uint64_t length);
+
+// UTF-8 helpers for lexers built on top of ParseC (like parsec.hpp), so they decode characters the
+// same way parsec_lex does. Both read at most [length] bytes from [ptr]. parsec_utf8_size returns
+// the size of the character at [ptr], or -1 if it isn't valid UTF-8. parsec_utf8_identifier returns
+// whether it can be part of an identifier, or start one if [head] is set.
+int8_t parsec_utf8_size(const char* ptr, uint64_t length);
+bool parsec_utf8_identifier(const char* ptr, uint64_t length, bool head);
 parsec_result parsec_lex(parsec* status, parsec_token* tokens, uint64_t token_count);
+// Statistics helpers, for exporting counters. Names are static strings.
+const char* parsec_kind_name(parsec_kind kind);
+const char* parsec_stat_section_name(parsec_stat_section section);
+void parsec_stats_reset(parsec* parser);
+void parsec_stats_merge(parsec_stats* into, const parsec_stats* from);
+
+// Keyword table API. [words] must outlive the table, and can't contain duplicates (init fails
+// with PARSEC_INVALID if it does). Once a table is set on a parser, the lexer stamps every KEY
+// token with its keyword index.
+parsec_result parsec_keywords_init(parsec_keywords* keywords, const char* const* words, uint32_t count);
+void parsec_keywords_deinit(parsec_keywords* keywords);
+int32_t parsec_keywords_find(const parsec_keywords* keywords, const char* str, parsec_idx length);
+void parsec_set_keywords(parsec* parser, const parsec_keywords* keywords);
+
+// Selects the number syntax [parser] uses from now on. Parsers start with PARSEC_DIALECT_DEFAULT.
+void parsec_set_dialect(parsec* parser, parsec_dialect dialect);
+
+// Lexes the next token only, into [token]. Returns the number of tokens lexed: 1, or 0 once the
+// end of the input is reached. Doesn't use (or change) [parser->next_token].
+parsec_result parsec_next(parsec* parser, parsec_token* token);
+
+// Same as parsec_lex and parsec_next, but numbers are converted while they are lexed, into the
+// value at the same index as their token. Values of other tokens are left untouched. INT tokens
+// that don't fit in an int64_t are clamped to INT64_MIN/INT64_MAX.
+parsec_result parsec_lex_values(parsec* parser, parsec_token* tokens, parsec_value* values,
+                                uint64_t token_count);
+parsec_result parsec_next_value(parsec* parser, parsec_token* token, parsec_value* value);
+
+// Lexes the rest of the input straight into the columns of [schemas], without going through a
+// token array. Lines that don't start with one of the schemas' keywords are skipped. Returns the
+// number of rows extracted, or PARSEC_NOMEM, with the parser's head on the record that didn't
+// fit, when a schema's columns are full.
+parsec_result parsec_extract(parsec* parser, parsec_schema* schemas, uint32_t schema_count);
+
+// Lexes the rest of the input on up to [thread_count] threads (0 picks one per online CPU). The
+// input is split at line boundaries, and the tokens are written to [tokens] in the same order,
+// with the same results, as parsec_lex would.
+parsec_result parsec_lex_parallel(parsec* parser, parsec_token* tokens, uint64_t token_count,
+                                  unsigned thread_count);
+// Token arena API. [allocator] can be NULL to use malloc/free. parsec_lex_arena lexes the rest of
+// the input, appending tokens to [arena], and returns the total number of tokens it holds.
+void parsec_arena_init(parsec_arena* arena, const parsec_allocator* allocator);
+void parsec_arena_deinit(parsec_arena* arena);
+parsec_result parsec_lex_arena(parsec* parser, parsec_arena* arena);
+
+// Returns a rough estimate of the number of tokens left in the input, from the density of tokens
+// in its first few lines, scaled to the size of the rest. Only the sample is read, so this is
+// cheap even on huge inputs. Meant to size token storage.
+uint64_t parsec_estimate_tokens(const parsec* parser);
+
+// Same as parsec_lex, but writing compact tokens. Both return PARSEC_OVERFLOW, with the parser's
+// head on the offending token, if a token starts more than 4GB into the input (or, for packed
+// tokens, is longer than PARSEC_PACKED_MAX_LENGTH). Bigger inputs can use segments instead.
+parsec_result parsec_lex_packed(parsec* parser, parsec_packed_token* tokens, uint64_t token_count);
+parsec_result parsec_lex_soa(parsec* parser, parsec_token_soa* tokens, uint64_t token_count);
+
+static inline parsec_kind parsec_packed_kind(parsec_packed_token token) {
+    return (parsec_kind)(int8_t)(token.info >> 24);
+}
+
+static inline parsec_idx parsec_packed_length(parsec_packed_token token) {
+    return token.info & PARSEC_PACKED_MAX_LENGTH;
+}
+
+static inline const char* parsec_packed_start(const parsec* parser, parsec_packed_token token) {
+    return parser->data + token.offset;
+}
+
+// Segmented token API. parsec_segments_init cuts the rest of [parser]'s input into line-aligned
+// segments of at most [segment_size] bytes (0 means PARSEC_SEGMENT_MAX), and fails with
+// PARSEC_OVERFLOW if a line doesn't fit in one. parsec_lex_segment lexes segment [index] only, and
+// doesn't change [parser]: different segments can be lexed on different threads at the same time.
+// parsec_lex_segments lexes every segment in order, and stops at the first one that fails, with
+// the parser's head on the offending token. It returns PARSEC_SUCCESS rather than a token count,
+// which could be too big for a parsec_result. Segments must be released with
+// parsec_segments_deinit.
+parsec_result parsec_segments_init(parsec_segments* segments, const parsec* parser,
+                                   uint64_t segment_size);
+void parsec_segments_deinit(parsec_segments* segments);
+parsec_result parsec_lex_segment(const parsec* parser, parsec_segments* segments, uint64_t index);
+parsec_result parsec_lex_segments(parsec* parser, parsec_segments* segments);
+
+static inline const char* parsec_segment_start(const parsec* parser, const parsec_segment* segment,
+                                               parsec_packed_token token) {
+    return parser->data + segment->base + token.offset;
+}
+
 bool parsec_token_cmp(parsec_token token, const char* str);
 double parsec_str_double(const char* parser, parsec_idx length);
-int32_t parsec_str_int(const char* parser, parsec_idx length);
+
+// Returns 0 if [ptr] isn't an integer, and clamps values that don't fit to INT32_MIN/INT32_MAX:
+// use the checked variants below to tell those apart from real values.
+int32_t parsec_str_int(const char* ptr, parsec_idx length);
+
+// Checked integer conversion. Returns PARSEC_INVALID if [ptr] isn't an integer, and
+// PARSEC_OVERFLOW if it doesn't fit: [value] is only written on success.
+parsec_result parsec_str_int64(const char* ptr, parsec_idx length, int64_t* value);
+parsec_result parsec_str_uint64(const char* ptr, parsec_idx length, uint64_t* value);
+
+// Maps the file at [path] read-only and initialises [parser] over it, so tokens point straight
+// into the page cache. Returns PARSEC_NOFILE if the file can't be opened or mapped. A parser
+// opened this way must be released with parsec_close_file.
+parsec_result parsec_open_file(parsec* parser, const char* path, char comment_char);
+void parsec_close_file(parsec* parser);
+
+// Updates [tokens], the [token_count] tokens [parser] lexed from a source before [edit], to match
+// the source after it, which starts at [data] (equal to [parser->data] for in-place edits). The
+// parser is moved over the new source, and only the lines touched by the edit are validated and
+// lexed again: the tokens before them are moved to the new buffer, and the ones after them are
+// also shifted by the size of the edit. Returns the new token count, or an error with [tokens]
+// left untouched (the parser is over the new source either way). PARSEC_NOMEM means the updated
+// tokens would need more than [capacity] entries.
+parsec_result parsec_relex(parsec* parser, const char* data, parsec_edit edit,
+                           parsec_token* tokens, uint64_t token_count, uint64_t capacity);
+
+// Line index API. Indices can be saved next to their source and loaded back without reading all
+// of it: loading fails with PARSEC_INVALID if [parser]'s input doesn't have the index's length and
+// the same bytes at a few sampled places, or if any line in the index doesn't start at the start
+// of the input or right after a line return. Lines and columns are counted from zero, and columns
+// are counted in codepoints.
+parsec_result parsec_index_build(const parsec* parser, parsec_line_index* index);
+void parsec_index_deinit(parsec_line_index* index);
+parsec_result parsec_index_save(const parsec_line_index* index, const char* path);
+parsec_result parsec_index_load(parsec_line_index* index, const char* path, const parsec* parser);
+uint64_t parsec_index_line_at(const parsec_line_index* index, uint64_t offset);
+void parsec_token_location(const parsec* parser, const parsec_line_index* index, const char* ptr,
+                           uint64_t* line, uint64_t* column);
+
+// Moves [parser]'s head to the start of [line], so lexing continues from there.
+parsec_result parsec_seek_line(parsec* parser, const parsec_line_index* index, uint64_t line);
+
+// Lexes [count] lines starting at [first], and nothing else, into [tokens] (starting at index 0).
+parsec_result parsec_lex_lines(parsec* parser, const parsec_line_index* index, uint64_t first,
+                               uint64_t count, parsec_token* tokens, uint64_t token_count);
+
+// Token cache API. parsec_cache_save writes [tokens] (and [values], if not NULL) lexed from
+// [parser]'s input to [path], along with a hash of the input. parsec_cache_load maps the cache
+// back, and fails with PARSEC_INVALID if it wasn't saved from the same input, with the same comment
+// character and dialect: a cache that loads can be used instead of lexing. Tokens are stored
+// packed, so saving fails with PARSEC_OVERFLOW for the same inputs parsec_lex_packed would.
+// Keyword indices aren't kept either: a parser with keywords set must look KEY tokens up again
+// with parsec_keywords_find. A loaded cache must be released with parsec_cache_close.
+uint64_t parsec_hash(const char* data, uint64_t length);
+parsec_result parsec_cache_save(const parsec* parser, const parsec_token* tokens,
+                                const parsec_value* values, uint64_t count, const char* path);
+parsec_result parsec_cache_load(parsec_token_cache* cache, const char* path, const parsec* parser);
+void parsec_cache_close(parsec_token_cache* cache);
+
+// Streaming API. Tokens written by parsec_feed/parsec_finish point into the stream's own buffer,
+// and are valid until the next call on the same stream: [chunk] can be reused as soon as
+// parsec_feed returns. Both functions return the number of tokens written to [tokens]. When
+// [tokens] fills up, they return PARSEC_NOMEM, with the number of tokens written in
+// [stream->parser.next_token]; calling parsec_feed with an empty chunk resumes lexing.
+void parsec_stream_init(parsec_stream* stream, char comment_char);
+void parsec_stream_deinit(parsec_stream* stream);
+parsec_result parsec_feed(parsec_stream* stream, const char* chunk, uint64_t length,
+                          parsec_token* tokens, uint64_t token_count);
+parsec_result parsec_finish(parsec_stream* stream, parsec_token* tokens, uint64_t token_count);
+
+// One input of parsec_lex_batch: either the file at [path], or (if [path] is NULL) the buffer
+// [parser] was initialised with. [tokens], [count] and [result] are filled in by the batch.
+struct parsec_batch_item_s {
+    const char*     path;
+    parsec          parser;
+    parsec_token*   tokens;
+    uint64_t        count;
+    parsec_result   result;
+};
+
+// Lexes every item on a work-stealing pool of [thread_count] threads (0 picks one per online CPU).
+// Files are mapped like parsec_open_file, with [comment_char], and large inputs are split at line
+// boundaries so a single big file doesn't hold up the batch. Each item ends up with its own token
+// array, and the result parsec_lex would have returned for it. Returns PARSEC_NOALLOC if the pool
+// can't be set up; otherwise the items must be released with parsec_batch_free.
+parsec_result parsec_lex_batch(parsec_batch_item* items, uint64_t item_count, char comment_char,
+                               unsigned thread_count);
+void parsec_batch_free(parsec_batch_item* items, uint64_t item_count);
+
+// Files are read, and decompressed if they start with a gzip or zstd header, on a background
+// thread while the caller lexes the blocks that are already decoded. Each format is only available
+// if ParseC was built with PARSEC_WITH_ZLIB or PARSEC_WITH_ZSTD; other archives fail to open with
+// PARSEC_NOFILE. parsec_reader_lex returns the number of tokens written to [tokens] (at most
+// [token_count]), 0 once the whole file has been lexed, or an error. As with parsec_feed, tokens
+// are only valid until the next call on the same reader.
+parsec_result parsec_reader_open(parsec_reader** reader, const char* path, char comment_char);
+parsec_result parsec_reader_lex(parsec_reader* reader, parsec_token* tokens, uint64_t token_count);
+void parsec_reader_close(parsec_reader* reader);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
 
 #endif /* _PARSEC_H_ */
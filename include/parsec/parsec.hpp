@@ -0,0 +1,321 @@
+//===--------------------------------------------------------------------------------------------===
+// parsec.hpp - Header-only C++17 front-end, with lexer dialects fixed at compile time
+// This source is part of ParseC
+//
+// Copyright (c) 2018 Amy Parent <amy@amyparent.com>
+// Licensed under the MIT License
+// =^•.•^=
+//===--------------------------------------------------------------------------------------------===
+#ifndef _PARSEC_HPP_
+#define _PARSEC_HPP_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <string_view>
+#include <parsec/parsec.h>
+#include <parsec/number_dfa.hpp>
+
+// parsec_lex reads its comment character from the parser, and checks it for every token. Here, a
+// dialect is a type: each one gets its own lexer, with its classification tables built at compile
+// time, so the hot loop never looks at anything but the input. Tokens are the ones parsec_lex
+// would produce for the same syntax, as views into the source, which is never copied.
+//
+// A dialect has the same members as parsecpp::default_dialect. [comment], [marker] and [quote] can
+// be '\0' to turn those tokens off, and [exponents] lists the characters that start an exponent
+// in numbers.
+
+namespace parsecpp {
+
+struct default_dialect {
+    static constexpr char comment = '#';
+    static constexpr char marker = '@';
+    static constexpr char quote = '\'';
+    static constexpr std::string_view exponents = "eEdD";
+};
+
+// Same syntax as PARSEC_DIALECT_C.
+struct c_dialect : default_dialect {
+    static constexpr std::string_view exponents = "eE";
+};
+
+struct token {
+    parsec_kind         kind;
+    std::string_view    text;
+};
+
+// MARK: - Dialect tables
+
+namespace detail {
+
+// What a byte starts, when it's found between tokens. Multibyte characters can only start keys,
+// which the UTF-8 helpers have to confirm.
+enum start_class : uint8_t {
+    START_INVALID,
+    START_SPACE,
+    START_NEWLINE,
+    START_KEY,
+    START_NUMBER,
+    START_COMMENT,
+    START_MARKER,
+    START_STRING,
+    START_UTF8,
+};
+
+constexpr bool is_space(unsigned c) {
+    return c == '\0' || c == ' ' || c == '\t' || c == '\v' || c == '\f' || c == '\r';
+}
+
+constexpr bool is_ident_head(unsigned c) {
+    return c == '_' || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+constexpr bool is_digit(unsigned c) {
+    return c >= '0' && c <= '9';
+}
+
+// Classes are assigned in the order token_type checks them in, so a dialect that reuses one
+// character for two things gets the same tokens from both lexers.
+template <typename Dialect>
+constexpr std::array<uint8_t, 256> make_start() {
+    std::array<uint8_t, 256> table{};
+    for(unsigned c = 0; c < 256; ++c) {
+        uint8_t cls = START_INVALID;
+        if(is_space(c))                                             cls = START_SPACE;
+        else if(c >= 0x80)                                          cls = START_UTF8;
+        else if(is_ident_head(c))                                   cls = START_KEY;
+        else if(is_digit(c) || c == '+' || c == '-' || c == '.')    cls = START_NUMBER;
+        else if(c == (uint8_t)Dialect::comment)                     cls = START_COMMENT;
+        else if(c == (uint8_t)Dialect::marker)                      cls = START_MARKER;
+        else if(c == (uint8_t)Dialect::quote)                       cls = START_STRING;
+        else if(c == '\n')                                          cls = START_NEWLINE;
+        table[c] = cls;
+    }
+    return table;
+}
+
+constexpr std::array<bool, 256> make_ident() {
+    std::array<bool, 256> table{};
+    for(unsigned c = 0; c < 256; ++c) table[c] = is_ident_head(c) || is_digit(c);
+    return table;
+}
+
+// Byte classes for the number DFA. Its transitions (number_dfa.hpp) are generated by parsec_numgen,
+// from the same rules as the C lexer's.
+template <typename Dialect>
+constexpr std::array<uint8_t, 256> make_number() {
+    std::array<uint8_t, 256> table{};
+    for(unsigned c = '0'; c <= '9'; ++c) table[c] = NUM_DIGIT;
+    table['+'] = table['-'] = NUM_SIGN;
+    table['.'] = NUM_POINT;
+    for(char c : Dialect::exponents) table[(uint8_t)c] = NUM_EXPONENT;
+    for(unsigned c = 0; c < 256; ++c) {
+        if(is_space(c) || c == '\n') table[c] = NUM_TERMINATOR;
+    }
+    return table;
+}
+
+template <typename Dialect>
+struct tables {
+    static_assert((uint8_t)Dialect::comment < 0x80 && (uint8_t)Dialect::marker < 0x80
+                  && (uint8_t)Dialect::quote < 0x80, "Dialect characters must be ASCII");
+    
+    static constexpr std::array<uint8_t, 256> start = make_start<Dialect>();
+    static constexpr std::array<bool, 256> ident = make_ident();
+    static constexpr std::array<uint8_t, 256> number = make_number<Dialect>();
+};
+
+} // namespace detail
+
+// MARK: - Lexer
+
+// Lexes [source] in [Dialect]. Like a parsec, the lexer only holds a head into the source, which
+// must outlive it (and the tokens). Lexing stops at the first invalid token, with the head left
+// where it failed, as parsec_next does.
+template <typename Dialect = default_dialect>
+class lexer {
+public:
+    explicit lexer(std::string_view source) noexcept
+        : data_(source.data())
+        , head_(source.data())
+        , end_(source.data() + source.size())
+        , validated_(parsec_utf8_valid(source.data(), source.size())) {}
+    
+    // Lexes the next token into [tok]. Returns 1, 0 once the end of the input is reached, or
+    // PARSEC_INVALID.
+    int next(token& tok) noexcept {
+        using tables = detail::tables<Dialect>;
+        while(head_ < end_ && tables::start[(uint8_t)*head_] == detail::START_SPACE) head_ += 1;
+        if(head_ >= end_) return PARSEC_SUCCESS;
+        
+        const char* start = head_;
+        switch(tables::start[(uint8_t)*head_]) {
+        case detail::START_KEY:
+            head_ += 1;
+            lex_key();
+            tok.kind = PARSEC_TOKEN_KEY;
+            break;
+            
+        case detail::START_UTF8:
+            if(!parsec_utf8_identifier(head_, end_ - head_, true)) return PARSEC_INVALID;
+            head_ += char_size();
+            lex_key();
+            tok.kind = PARSEC_TOKEN_KEY;
+            break;
+            
+        case detail::START_NUMBER:
+            if(!lex_number(tok.kind)) return PARSEC_INVALID;
+            break;
+            
+        case detail::START_COMMENT: {
+            const void* line = std::memchr(head_, '\n', end_ - head_);
+            head_ = line ? static_cast<const char*>(line) : end_;
+            tok.kind = PARSEC_TOKEN_COMMENT;
+            break;
+        }
+        
+        case detail::START_MARKER:
+            head_ += 1;
+            tok.kind = PARSEC_TOKEN_MARKER;
+            break;
+            
+        case detail::START_NEWLINE:
+            head_ += 1;
+            tok.kind = PARSEC_TOKEN_NEWLINE;
+            break;
+            
+        case detail::START_STRING:
+            if(!lex_string()) return PARSEC_INVALID;
+            tok.kind = PARSEC_TOKEN_STRING;
+            break;
+            
+        default:
+            return PARSEC_INVALID;
+        }
+        tok.text = std::string_view(start, head_ - start);
+        return 1;
+    }
+    
+    // Appends the rest of the tokens to [tokens] (anything with push_back, like a
+    // std::vector<parsecpp::token>). Returns the number of tokens appended, or PARSEC_INVALID.
+    template <typename Container>
+    std::ptrdiff_t lex(Container& tokens) {
+        std::ptrdiff_t count = 0;
+        token tok;
+        int result;
+        while((result = next(tok)) > 0) {
+            tokens.push_back(tok);
+            count += 1;
+        }
+        return result < 0 ? result : count;
+    }
+    
+    // Byte offset of the head into the source: where the next token will be looked for, or where
+    // the last one failed.
+    uint64_t offset() const noexcept { return head_ - data_; }
+    bool done() const noexcept { return head_ >= end_; }
+    
+    // Tokens as a range, for range-based for loops. Iteration ends with the input, or at the first
+    // invalid token: done() tells the two apart afterwards.
+    class iterator {
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = token;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const token*;
+        using reference = const token&;
+        
+        iterator() noexcept = default;
+        explicit iterator(lexer* lex) noexcept : lexer_(lex) { ++*this; }
+        
+        reference operator*() const noexcept { return token_; }
+        pointer operator->() const noexcept { return &token_; }
+        iterator& operator++() noexcept {
+            if(lexer_->next(token_) <= 0) lexer_ = nullptr;
+            return *this;
+        }
+        void operator++(int) noexcept { ++*this; }
+        bool operator==(const iterator& other) const noexcept { return lexer_ == other.lexer_; }
+        bool operator!=(const iterator& other) const noexcept { return lexer_ != other.lexer_; }
+        
+    private:
+        lexer*  lexer_ = nullptr;
+        token   token_{};
+    };
+    
+    iterator begin() noexcept { return iterator(this); }
+    iterator end() noexcept { return iterator(); }
+
+private:
+    // Size of the multibyte character at the head, or -1 if it isn't valid UTF-8. Once the input
+    // is known to be valid, the lead byte is all it takes.
+    int8_t char_size() const noexcept {
+        if(!validated_) return parsec_utf8_size(head_, end_ - head_);
+        uint8_t lead = (uint8_t)*head_;
+        return lead < 0xe0 ? 2 : lead < 0xf0 ? 3 : 4;
+    }
+    
+    // The head is past the first character of the key.
+    void lex_key() noexcept {
+        using tables = detail::tables<Dialect>;
+        for(;;) {
+            while(head_ < end_ && tables::ident[(uint8_t)*head_]) head_ += 1;
+            // Only non-ASCII characters need to go through the (slow) UTF-8 identifier ranges
+            if(head_ >= end_ || (uint8_t)*head_ < 0x80) return;
+            if(!parsec_utf8_identifier(head_, end_ - head_, false)) return;
+            head_ += char_size();
+        }
+    }
+    
+    // Past the end of the input, the DFA reads a terminator, like the C lexer does.
+    bool lex_number(parsec_kind& kind) noexcept {
+        using tables = detail::tables<Dialect>;
+        const char* head = head_;
+        uint8_t state = detail::NUM_START;
+        for(;;) {
+            uint8_t cls = detail::NUM_TERMINATOR;
+            if(head < end_) cls = tables::number[(uint8_t)*head];
+            state = detail::number_transitions[state][cls];
+            if(state >= detail::NUM_INT) break;
+            head += 1;
+            
+            if(cls != detail::NUM_DIGIT) continue;
+            while(head < end_ && tables::number[(uint8_t)*head] == detail::NUM_DIGIT) head += 1;
+        }
+        head_ = head;
+        kind = state == detail::NUM_INT ? PARSEC_TOKEN_INT : PARSEC_TOKEN_FLOAT;
+        return state != detail::NUM_INVALID;
+    }
+    
+    // Strings can't span lines. Unless the whole input was found to be valid UTF-8 up front,
+    // multibyte characters in them are checked one by one.
+    bool lex_string() noexcept {
+        head_ += 1;
+        for(;;) {
+            if(head_ >= end_) return false;
+            uint8_t c = (uint8_t)*head_;
+            if(c == (uint8_t)Dialect::quote) break;
+            if(c == '\n') return false;
+            if(c < 0x80 || validated_) {
+                head_ += 1;
+                continue;
+            }
+            int8_t size = char_size();
+            if(size < 0) return false;
+            head_ += size;
+        }
+        head_ += 1;
+        return true;
+    }
+    
+    const char* data_;
+    const char* head_;
+    const char* end_;
+    bool        validated_;
+};
+
+} // namespace parsecpp
+
+#endif /* _PARSEC_HPP_ */
@@ -0,0 +1,130 @@
+//===--------------------------------------------------------------------------------------------===
+// arena.c - Growable token storage
+// This source is part of ParseC
+//
+// Copyright (c) 2018 Amy Parent <amy@amyparent.com>
+// Licensed under the MIT License
+// =^•.•^=
+//===--------------------------------------------------------------------------------------------===
+#include "scan.h"
+#include <assert.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <parsec/parsec.h>
+
+#define ARENA_MIN_BLOCK     (4 * 1024)
+#define ESTIMATE_SAMPLE     (64 * 1024)
+
+static void* default_alloc(uint64_t size, void* user) {
+    (void)user;
+    return malloc(size);
+}
+
+static void default_free(void* ptr, uint64_t size, void* user) {
+    (void)size;
+    (void)user;
+    free(ptr);
+}
+
+// Blocks are allocated in one go: the header, followed by the tokens.
+static parsec_arena_block* arena_grow(parsec_arena* arena, uint64_t capacity) {
+    uint64_t size = sizeof(parsec_arena_block) + capacity * sizeof(parsec_token);
+    parsec_arena_block* block = arena->allocator.alloc(size, arena->allocator.user);
+    if(!block) return NULL;
+    
+    block->next = NULL;
+    block->tokens = (parsec_token*)(block + 1);
+    block->count = 0;
+    block->capacity = capacity;
+    
+    if(arena->last) arena->last->next = block;
+    else arena->first = block;
+    arena->last = block;
+    return block;
+}
+
+void parsec_arena_init(parsec_arena* arena, const parsec_allocator* allocator) {
+    assert(arena && "Invalid ParseC arena given");
+    static const parsec_allocator malloc_allocator = { default_alloc, default_free, NULL };
+    arena->allocator = allocator ? *allocator : malloc_allocator;
+    arena->first = arena->last = NULL;
+    arena->count = 0;
+}
+
+void parsec_arena_deinit(parsec_arena* arena) {
+    assert(arena && "Invalid ParseC arena given");
+    parsec_arena_block* block = arena->first;
+    while(block) {
+        parsec_arena_block* next = block->next;
+        uint64_t size = sizeof(parsec_arena_block) + block->capacity * sizeof(parsec_token);
+        arena->allocator.free(block, size, arena->allocator.user);
+        block = next;
+    }
+    arena->first = arena->last = NULL;
+    arena->count = 0;
+}
+
+parsec_result parsec_lex_arena(parsec* parser, parsec_arena* arena) {
+    assert(parser && "Invalid ParseC status given");
+    assert(arena && "Invalid ParseC arena given");
+    
+    parsec_idx next_token = parser->next_token;
+    parsec_result result;
+    
+    for(;;) {
+        parsec_arena_block* block = arena->last;
+        if(!block || block->count == block->capacity) {
+            // The first block is sized from an estimate, and later ones double the storage.
+            uint64_t capacity = block ? arena->count : parsec_estimate_tokens(parser);
+            if(capacity < ARENA_MIN_BLOCK) capacity = ARENA_MIN_BLOCK;
+            block = arena_grow(arena, capacity);
+            if(!block) {
+                result = PARSEC_NOALLOC;
+                break;
+            }
+        }
+        
+        parser->next_token = block->count;
+        result = parsec_lex(parser, block->tokens, block->capacity);
+        
+        // An invalid token still takes a slot, which we don't want to keep around.
+        uint64_t count = parser->next_token - (result == PARSEC_INVALID ? 1 : 0);
+        arena->count += count - block->count;
+        block->count = count;
+        if(result != PARSEC_NOMEM) break;
+    }
+    
+    parser->next_token = next_token;
+    return result < 0 ? result : (parsec_result)arena->count;
+}
+
+uint64_t parsec_estimate_tokens(const parsec* parser) {
+    assert(parser && "Invalid ParseC status given");
+    
+    // Lex a sample of whole lines from the start of the input.
+    parsec sample = *parser;
+    if(sample.end - sample.head > ESTIMATE_SAMPLE) {
+        sample.end = scan_newline(sample.head + ESTIMATE_SAMPLE, parser->end);
+        if(sample.end < parser->end) sample.end += 1;
+    }
+    uint64_t sample_bytes = sample.end - sample.head;
+    
+    uint64_t tokens = 0;
+    parsec_token buffer[256];
+    for(;;) {
+        sample.next_token = 0;
+        parsec_result result = parsec_lex(&sample, buffer, 256);
+        tokens += sample.next_token;
+        if(result != PARSEC_NOMEM) break;
+    }
+    if(sample.end == parser->end) return tokens;
+    
+    // Then scale it by the size of the whole input: counting its lines would mean reading all of
+    // it, which is most of what lexing it costs. The sample is made of whole lines, so its token
+    // density carries over to the rest of the input as well as its line density would.
+    uint64_t bytes = parser->end - parser->head;
+    
+    // Lines vary in length, so leave some headroom to avoid growing the storage right at the end.
+    uint64_t estimate = (uint64_t)((double)tokens * bytes / sample_bytes);
+    return estimate + estimate / 8;
+}
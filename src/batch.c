@@ -0,0 +1,302 @@
+//===--------------------------------------------------------------------------------------------===
+// batch.c - Lexing many inputs at once on a work-stealing thread pool
+// This source is part of ParseC
+//
+// Copyright (c) 2018 Amy Parent <amy@amyparent.com>
+// Licensed under the MIT License
+// =^•.•^=
+//===--------------------------------------------------------------------------------------------===
+#include "parallel.h"
+#include <assert.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <parsec/parsec.h>
+
+// Inputs bigger than this are split into line-aligned pieces that other workers can steal, so
+// one huge file can't hold up the whole batch.
+#define BATCH_PIECE_SIZE    (4 * PARALLEL_MIN_CHUNK)
+#define BATCH_OPEN          UINT_MAX
+
+typedef struct {
+    parsec_batch_item*  item;
+    parallel_job*       jobs;
+    unsigned            job_count;
+    unsigned            pending;
+} batch_input;
+
+// Either opens and splits an input ([piece] is BATCH_OPEN), or lexes one of its pieces.
+typedef struct {
+    batch_input*        input;
+    unsigned            piece;
+} batch_task;
+
+// The owner pushes and pops at the tail, thieves take from the head: the owner keeps working on
+// the pieces it just split, while the oldest (and usually biggest) tasks get stolen.
+typedef struct {
+    pthread_mutex_t     lock;
+    batch_task*         tasks;
+    uint64_t            head;
+    uint64_t            tail;
+    uint64_t            capacity;
+} batch_deque;
+
+// Workers with nothing to steal sleep on [wake] until new tasks are pushed or the batch is done.
+// Every wake-up bumps [generation], so a worker that saw a generation before looking through the
+// deques knows whether it missed one while it was looking.
+typedef struct {
+    batch_deque*        deques;
+    unsigned            worker_count;
+    uint64_t            remaining;
+    char                comment_char;
+    pthread_mutex_t     idle_lock;
+    pthread_cond_t      wake;
+    uint64_t            generation;
+} batch_pool;
+
+typedef struct {
+    batch_pool*         pool;
+    unsigned            index;
+} batch_worker;
+
+// MARK: - Deques
+
+static bool batch_push(batch_deque* deque, batch_task task) {
+    pthread_mutex_lock(&deque->lock);
+    if(deque->tail == deque->capacity && deque->head) {
+        memmove(deque->tasks, deque->tasks + deque->head,
+                (deque->tail - deque->head) * sizeof(batch_task));
+        deque->tail -= deque->head;
+        deque->head = 0;
+    }
+    if(deque->tail == deque->capacity) {
+        uint64_t capacity = deque->capacity ? deque->capacity * 2 : 64;
+        batch_task* tasks = realloc(deque->tasks, capacity * sizeof(batch_task));
+        if(!tasks) {
+            pthread_mutex_unlock(&deque->lock);
+            return false;
+        }
+        deque->tasks = tasks;
+        deque->capacity = capacity;
+    }
+    deque->tasks[deque->tail++] = task;
+    pthread_mutex_unlock(&deque->lock);
+    return true;
+}
+
+static bool batch_pop(batch_deque* deque, batch_task* task) {
+    pthread_mutex_lock(&deque->lock);
+    bool found = deque->tail > deque->head;
+    if(found) *task = deque->tasks[--deque->tail];
+    pthread_mutex_unlock(&deque->lock);
+    return found;
+}
+
+static bool batch_steal(batch_deque* deque, batch_task* task) {
+    pthread_mutex_lock(&deque->lock);
+    bool found = deque->tail > deque->head;
+    if(found) *task = deque->tasks[deque->head++];
+    pthread_mutex_unlock(&deque->lock);
+    return found;
+}
+
+// MARK: - Idling
+
+static void batch_wake(batch_pool* pool) {
+    pthread_mutex_lock(&pool->idle_lock);
+    __atomic_add_fetch(&pool->generation, 1, __ATOMIC_RELEASE);
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->idle_lock);
+}
+
+static void batch_idle(batch_pool* pool, uint64_t seen) {
+    pthread_mutex_lock(&pool->idle_lock);
+    while(__atomic_load_n(&pool->generation, __ATOMIC_ACQUIRE) == seen
+          && __atomic_load_n(&pool->remaining, __ATOMIC_ACQUIRE))
+        pthread_cond_wait(&pool->wake, &pool->idle_lock);
+    pthread_mutex_unlock(&pool->idle_lock);
+}
+
+// MARK: - Tasks
+
+// Same rules as parsec_lex_parallel: the pieces are joined in order, up to and including the
+// first one that didn't lex cleanly.
+static void batch_stitch(batch_input* input) {
+    parsec_batch_item* item = input->item;
+    parsec_result result = PARSEC_SUCCESS;
+    uint64_t count = 0;
+    unsigned used = 0;
+    while(used < input->job_count && result == PARSEC_SUCCESS) {
+        parallel_job* job = &input->jobs[used++];
+        count += job->parser.next_token;
+        if(job->result < 0) result = job->result;
+    }
+    
+    item->tokens = count ? malloc(count * sizeof(parsec_token)) : NULL;
+    if(count && !item->tokens) {
+        result = PARSEC_NOALLOC;
+        count = used = 0;
+    }
+    
+    item->count = 0;
+    for(unsigned i = 0; i < used; ++i) {
+        parallel_job* job = &input->jobs[i];
+        memcpy(item->tokens + item->count, job->tokens, job->parser.next_token * sizeof(parsec_token));
+        item->count += job->parser.next_token;
+        item->parser.head = job->parser.head;
+    }
+    item->parser.next_token = item->count;
+    item->result = result == PARSEC_SUCCESS ? (parsec_result)item->count : result;
+
+#ifdef PARSEC_STATS
+    for(unsigned i = 0; i < input->job_count; ++i)
+        parsec_stats_merge(&item->parser.stats, &input->jobs[i].parser.stats);
+#endif
+    for(unsigned i = 0; i < input->job_count; ++i) {
+        if(input->jobs[i].owned) free(input->jobs[i].tokens);
+    }
+    free(input->jobs);
+    input->jobs = NULL;
+}
+
+static void batch_run(batch_pool* pool, unsigned worker, batch_task task);
+
+static void batch_lex(batch_input* input, unsigned piece) {
+    parallel_lex(&input->jobs[piece]);
+    if(__atomic_sub_fetch(&input->pending, 1, __ATOMIC_ACQ_REL) == 0) batch_stitch(input);
+}
+
+static void batch_open(batch_pool* pool, unsigned worker, batch_input* input) {
+    parsec_batch_item* item = input->item;
+    if(item->path) {
+        item->result = parsec_open_file(&item->parser, item->path, pool->comment_char);
+        if(item->result != PARSEC_SUCCESS) return;
+    }
+    
+    uint64_t size = item->parser.end - item->parser.head;
+    uint64_t pieces = size / BATCH_PIECE_SIZE + 1;
+    input->jobs = calloc(pieces, sizeof(parallel_job));
+    if(!input->jobs) {
+        item->result = PARSEC_NOALLOC;
+        return;
+    }
+    input->job_count = parallel_split(&item->parser, input->jobs, (unsigned)pieces);
+    if(!input->job_count) {
+        batch_stitch(input);
+        return;
+    }
+    
+    // Every piece but the first goes up for grabs; this worker starts on the first one right away.
+    input->pending = input->job_count;
+    __atomic_add_fetch(&pool->remaining, input->job_count - 1, __ATOMIC_ACQ_REL);
+    for(unsigned i = input->job_count - 1; i > 0; --i) {
+        batch_task piece = {input, i};
+        if(!batch_push(&pool->deques[worker], piece)) batch_run(pool, worker, piece);
+    }
+    batch_wake(pool);
+    batch_lex(input, 0);
+}
+
+static void batch_run(batch_pool* pool, unsigned worker, batch_task task) {
+    if(task.piece == BATCH_OPEN) batch_open(pool, worker, task.input);
+    else batch_lex(task.input, task.piece);
+    if(__atomic_sub_fetch(&pool->remaining, 1, __ATOMIC_ACQ_REL) == 0) batch_wake(pool);
+}
+
+// Workers go back to their own deque first, and only look at the others' once it's empty.
+static void* batch_work(void* data) {
+    batch_worker* worker = data;
+    batch_pool* pool = worker->pool;
+    
+    while(__atomic_load_n(&pool->remaining, __ATOMIC_ACQUIRE)) {
+        uint64_t seen = __atomic_load_n(&pool->generation, __ATOMIC_ACQUIRE);
+        batch_task task;
+        bool found = batch_pop(&pool->deques[worker->index], &task);
+        for(unsigned i = 1; !found && i < pool->worker_count; ++i) {
+            unsigned victim = (worker->index + i) % pool->worker_count;
+            found = batch_steal(&pool->deques[victim], &task);
+        }
+        if(found) batch_run(pool, worker->index, task);
+        else batch_idle(pool, seen);
+    }
+    return NULL;
+}
+
+// MARK: - Public API implementation
+
+parsec_result parsec_lex_batch(parsec_batch_item* items, uint64_t item_count, char comment_char,
+                               unsigned thread_count) {
+    assert((items || !item_count) && "Invalid batch items given");
+    if(!item_count) return PARSEC_SUCCESS;
+    
+    if(!thread_count) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        thread_count = cpus > 0 ? (unsigned)cpus : 1;
+    }
+    
+    batch_input* inputs = calloc(item_count, sizeof(batch_input));
+    batch_deque* deques = calloc(thread_count, sizeof(batch_deque));
+    batch_worker* workers = calloc(thread_count, sizeof(batch_worker));
+    pthread_t* threads = calloc(thread_count, sizeof(pthread_t));
+    bool* started = calloc(thread_count, sizeof(bool));
+    if(!inputs || !deques || !workers || !threads || !started) {
+        free(inputs);
+        free(deques);
+        free(workers);
+        free(threads);
+        free(started);
+        return PARSEC_NOALLOC;
+    }
+    
+    batch_pool pool = {deques, thread_count, item_count, comment_char};
+    pthread_mutex_init(&pool.idle_lock, NULL);
+    pthread_cond_init(&pool.wake, NULL);
+    for(unsigned i = 0; i < thread_count; ++i) {
+        pthread_mutex_init(&deques[i].lock, NULL);
+        workers[i] = (batch_worker){&pool, i};
+    }
+    
+    // Inputs are dealt out round-robin; stealing evens out whatever that gets wrong.
+    for(uint64_t i = 0; i < item_count; ++i) {
+        batch_task task = {&inputs[i], BATCH_OPEN};
+        inputs[i].item = &items[i];
+        items[i].tokens = NULL;
+        items[i].count = 0;
+        items[i].result = PARSEC_SUCCESS;
+        if(!batch_push(&deques[i % thread_count], task)) batch_run(&pool, 0, task);
+    }
+    
+    // The calling thread is worker 0, and there's nothing to lose if other threads won't start.
+    for(unsigned i = 1; i < thread_count; ++i)
+        started[i] = pthread_create(&threads[i], NULL, batch_work, &workers[i]) == 0;
+    batch_work(&workers[0]);
+    for(unsigned i = 1; i < thread_count; ++i) {
+        if(started[i]) pthread_join(threads[i], NULL);
+    }
+    
+    for(unsigned i = 0; i < thread_count; ++i) {
+        pthread_mutex_destroy(&deques[i].lock);
+        free(deques[i].tasks);
+    }
+    pthread_cond_destroy(&pool.wake);
+    pthread_mutex_destroy(&pool.idle_lock);
+    free(inputs);
+    free(deques);
+    free(workers);
+    free(threads);
+    free(started);
+    return PARSEC_SUCCESS;
+}
+
+void parsec_batch_free(parsec_batch_item* items, uint64_t item_count) {
+    assert((items || !item_count) && "Invalid batch items given");
+    for(uint64_t i = 0; i < item_count; ++i) {
+        free(items[i].tokens);
+        items[i].tokens = NULL;
+        items[i].count = 0;
+        if(items[i].path && items[i].result != PARSEC_NOFILE) parsec_close_file(&items[i].parser);
+    }
+}
@@ -0,0 +1,224 @@
+//===--------------------------------------------------------------------------------------------===
+// cache.c - On-disk token cache, validated against a hash of the source
+// This source is part of ParseC
+//
+// Copyright (c) 2018 Amy Parent <amy@amyparent.com>
+// Licensed under the MIT License
+// =^•.•^=
+//===--------------------------------------------------------------------------------------------===
+#include <assert.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <parsec/parsec.h>
+
+static const char cache_magic[8] = { 'P', 'S', 'C', 'T', 'O', 'K', '0', '2' };
+
+#define CACHE_HAS_VALUES    (1u << 0)
+#define CACHE_BATCH         4096
+
+// Like line indices, caches are written in native byte order. The header keeps the tokens (and
+// values) that follow it 8-byte aligned, so they can be used straight from the mapping.
+typedef struct {
+    char        magic[8];
+    uint64_t    length;
+    uint64_t    hash;
+    uint64_t    count;
+    uint32_t    flags;
+    uint32_t    comment_char;
+    uint32_t    dialect;
+    uint32_t    reserved;
+} cache_header;
+
+// MARK: - Hashing
+
+// XXH64: fast enough that hashing the source costs a fraction of lexing it.
+#define HASH_PRIME1 0x9e3779b185ebca87ull
+#define HASH_PRIME2 0xc2b2ae3d27d4eb4full
+#define HASH_PRIME3 0x165667b19e3779f9ull
+#define HASH_PRIME4 0x85ebca77c2b2ae63ull
+#define HASH_PRIME5 0x27d4eb2f165667c5ull
+
+static inline uint64_t hash_rotate(uint64_t x, int bits) {
+    return (x << bits) | (x >> (64 - bits));
+}
+
+static inline uint64_t hash_load64(const char* ptr) {
+    uint64_t value;
+    memcpy(&value, ptr, sizeof(value));
+    return value;
+}
+
+static inline uint32_t hash_load32(const char* ptr) {
+    uint32_t value;
+    memcpy(&value, ptr, sizeof(value));
+    return value;
+}
+
+static inline uint64_t hash_round(uint64_t acc, uint64_t input) {
+    acc += input * HASH_PRIME2;
+    return hash_rotate(acc, 31) * HASH_PRIME1;
+}
+
+static inline uint64_t hash_merge(uint64_t acc, uint64_t lane) {
+    acc ^= hash_round(0, lane);
+    return acc * HASH_PRIME1 + HASH_PRIME4;
+}
+
+uint64_t parsec_hash(const char* data, uint64_t length) {
+    assert((data || !length) && "Invalid data given");
+    const char* ptr = data;
+    const char* end = data + length;
+    uint64_t hash;
+    
+    if(length >= 32) {
+        uint64_t lanes[4] = { HASH_PRIME1 + HASH_PRIME2, HASH_PRIME2, 0, -HASH_PRIME1 };
+        for(; end - ptr >= 32; ptr += 32) {
+            for(int i = 0; i < 4; ++i) lanes[i] = hash_round(lanes[i], hash_load64(ptr + 8 * i));
+        }
+        hash = hash_rotate(lanes[0], 1) + hash_rotate(lanes[1], 7)
+             + hash_rotate(lanes[2], 12) + hash_rotate(lanes[3], 18);
+        for(int i = 0; i < 4; ++i) hash = hash_merge(hash, lanes[i]);
+    } else {
+        hash = HASH_PRIME5;
+    }
+    hash += length;
+    
+    for(; end - ptr >= 8; ptr += 8)
+        hash = hash_rotate(hash ^ hash_round(0, hash_load64(ptr)), 27) * HASH_PRIME1 + HASH_PRIME4;
+    if(end - ptr >= 4) {
+        hash = hash_rotate(hash ^ (hash_load32(ptr) * HASH_PRIME1), 23) * HASH_PRIME2 + HASH_PRIME3;
+        ptr += 4;
+    }
+    for(; ptr < end; ++ptr)
+        hash = hash_rotate(hash ^ ((uint8_t)*ptr * HASH_PRIME5), 11) * HASH_PRIME1;
+    
+    hash ^= hash >> 33;
+    hash *= HASH_PRIME2;
+    hash ^= hash >> 29;
+    hash *= HASH_PRIME3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+// MARK: - Public API implementation
+
+// Tokens are written through a small buffer so they can be packed on the way out.
+parsec_result parsec_cache_save(const parsec* parser, const parsec_token* tokens,
+                                const parsec_value* values, uint64_t count, const char* path) {
+    assert(parser && "Invalid ParseC status given");
+    assert((tokens || !count) && "Invalid token array given");
+    assert(path && "Invalid file path given");
+    
+    cache_header header = {
+        .length = parser->end - parser->data,
+        .hash = parsec_hash(parser->data, parser->end - parser->data),
+        .count = count,
+        .flags = values ? CACHE_HAS_VALUES : 0,
+        .comment_char = (uint8_t)parser->comment_char,
+        .dialect = parser->dialect,
+    };
+    memcpy(header.magic, cache_magic, sizeof(cache_magic));
+    
+    for(uint64_t i = 0; i < count; ++i) {
+        if(tokens[i].start < parser->data || tokens[i].start > parser->end
+           || (uint64_t)(tokens[i].start - parser->data) > UINT32_MAX
+           || tokens[i].length > PARSEC_PACKED_MAX_LENGTH) return PARSEC_OVERFLOW;
+    }
+    
+    FILE* file = fopen(path, "wb");
+    if(!file) return PARSEC_NOFILE;
+    
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+    parsec_packed_token packed[CACHE_BATCH];
+    for(uint64_t i = 0; i < count && ok; i += CACHE_BATCH) {
+        uint64_t batch = count - i < CACHE_BATCH ? count - i : CACHE_BATCH;
+        for(uint64_t j = 0; j < batch; ++j) {
+            const parsec_token* token = &tokens[i + j];
+            packed[j].offset = (uint32_t)(token->start - parser->data);
+            packed[j].info = token->length | ((uint32_t)(uint8_t)token->kind << 24);
+        }
+        ok = fwrite(packed, sizeof(parsec_packed_token), batch, file) == batch;
+    }
+    if(values && ok) ok = fwrite(values, sizeof(parsec_value), count, file) == count;
+    ok = fclose(file) == 0 && ok;
+    if(!ok) remove(path);
+    return ok ? PARSEC_SUCCESS : PARSEC_NOFILE;
+}
+
+parsec_result parsec_cache_load(parsec_token_cache* cache, const char* path, const parsec* parser) {
+    assert(cache && "Invalid token cache given");
+    assert(path && "Invalid file path given");
+    assert(parser && "Invalid ParseC status given");
+    
+    cache->tokens = NULL;
+    cache->values = NULL;
+    cache->count = 0;
+    cache->mapping = NULL;
+    cache->size = 0;
+    
+    int fd = open(path, O_RDONLY);
+    if(fd < 0) return PARSEC_NOFILE;
+    struct stat info;
+    if(fstat(fd, &info) != 0 || !S_ISREG(info.st_mode)) {
+        close(fd);
+        return PARSEC_NOFILE;
+    }
+    if((uint64_t)info.st_size < sizeof(cache_header)) {
+        close(fd);
+        return PARSEC_INVALID;
+    }
+    
+    uint64_t size = (uint64_t)info.st_size;
+    void* mapping = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(mapping == MAP_FAILED) return PARSEC_NOFILE;
+    
+    // The cheap checks go first, so a stale cache is usually caught before the source is hashed.
+    const cache_header* header = mapping;
+    uint64_t length = parser->end - parser->data;
+    uint64_t record = sizeof(parsec_packed_token)
+                    + (header->flags & CACHE_HAS_VALUES ? sizeof(parsec_value) : 0);
+    if(memcmp(header->magic, cache_magic, sizeof(cache_magic)) != 0
+       || header->length != length
+       || header->comment_char != (uint8_t)parser->comment_char
+       || header->dialect != (uint32_t)parser->dialect
+       || header->count > (size - sizeof(cache_header)) / record
+       || sizeof(cache_header) + header->count * record != size
+       || header->hash != parsec_hash(parser->data, length)) {
+        munmap(mapping, size);
+        return PARSEC_INVALID;
+    }
+    
+    // The hash makes it very unlikely for a token to fall outside of the source, but a tampered
+    // cache would still be caught here, before anything reads through it.
+    const parsec_packed_token* tokens = (const void*)(header + 1);
+    for(uint64_t i = 0; i < header->count; ++i) {
+        if((uint64_t)tokens[i].offset + parsec_packed_length(tokens[i]) > length) {
+            munmap(mapping, size);
+            return PARSEC_INVALID;
+        }
+    }
+    
+    madvise(mapping, size, MADV_WILLNEED);
+    cache->tokens = tokens;
+    cache->values = header->flags & CACHE_HAS_VALUES ? (const void*)(tokens + header->count) : NULL;
+    cache->count = header->count;
+    cache->mapping = mapping;
+    cache->size = size;
+    return PARSEC_SUCCESS;
+}
+
+void parsec_cache_close(parsec_token_cache* cache) {
+    assert(cache && "Invalid token cache given");
+    if(cache->mapping) munmap(cache->mapping, cache->size);
+    cache->tokens = NULL;
+    cache->values = NULL;
+    cache->count = 0;
+    cache->mapping = NULL;
+    cache->size = 0;
+}
@@ -0,0 +1,230 @@
+//===--------------------------------------------------------------------------------------------===
+// convert.c - Conversion of numeric tokens to their values
+// This source is part of ParseC
+//
+// Copyright (c) 2018 Amy Parent <amy@amyparent.com>
+// Licensed under the MIT License
+// =^•.•^=
+//===--------------------------------------------------------------------------------------------===
+#include "convert.h"
+#include <float.h>
+#include <locale.h>
+#include <stdlib.h>
+#include <string.h>
+#include <parsec/parsec.h>
+
+// MARK: - Floating point conversion
+
+// Every power of ten up to 10^22 is exactly representable as a double.
+static const double powers_of_ten[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+#define MAX_EXACT_POWER     22
+#define MAX_EXACT_MANTISSA  (UINT64_C(1) << 53)
+
+// Clinger's fast path: when both the mantissa and the power of ten are exact doubles, a single
+// multiplication or division gives the correctly rounded result. This covers the vast majority of
+// the numbers found in data files (up to 15 significant digits, with small exponents).
+bool convert_fast_double(bool negative, uint64_t mantissa, int64_t exponent, double* out) {
+#if FLT_EVAL_METHOD == 0
+    if(mantissa == 0) {
+        *out = negative ? -0.0 : 0.0;
+        return true;
+    }
+    if(mantissa > MAX_EXACT_MANTISSA) return false;
+    
+    // 123e25 is also 123000e22: move the extra powers into the mantissa while it stays exact.
+    while(exponent > MAX_EXACT_POWER && mantissa <= MAX_EXACT_MANTISSA / 10) {
+        mantissa *= 10;
+        exponent -= 1;
+    }
+    if(exponent < -MAX_EXACT_POWER || exponent > MAX_EXACT_POWER) return false;
+    
+    double value = (double)mantissa;
+    value = exponent < 0 ? value / powers_of_ten[-exponent] : value * powers_of_ten[exponent];
+    *out = negative ? -value : value;
+    return true;
+#else
+    // With extended precision intermediates, the result would be rounded twice.
+    return false;
+#endif
+}
+
+double convert_slow_double(const char* ptr, uint64_t length) {
+    // strtod is correctly rounded, but it needs a NUL-terminated string, doesn't know about
+    // Fortran-style exponents and follows the locale's decimal point.
+    char local[128];
+    char* buffer = length < sizeof(local) ? local : malloc(length + 1);
+    if(!buffer) return 0.0;
+    
+    char point = localeconv()->decimal_point[0];
+    for(uint64_t i = 0; i < length; ++i) {
+        char c = ptr[i];
+        if(c == 'd' || c == 'D') c = 'e';
+        else if(c == '.') c = point;
+        buffer[i] = c;
+    }
+    buffer[length] = '\0';
+    
+    double value = strtod(buffer, NULL);
+    if(buffer != local) free(buffer);
+    return value;
+}
+
+double parsec_str_double(const char* ptr, parsec_idx length) {
+    const char* start = ptr;
+    const char* end = ptr + length;
+    bool negative = false;
+    bool truncated = false;
+    uint64_t mantissa = 0;
+    int64_t exponent = 0;
+    int digits = 0;
+    
+    if(ptr != end && (*ptr == '-' || *ptr == '+')) {
+        negative = *ptr == '-';
+        ptr++;
+    }
+    
+    // Leading zeroes don't count towards the significant digits we can keep.
+    while(ptr != end && *ptr == '0') ptr++;
+    for(; ptr != end && *ptr >= '0' && *ptr <= '9'; ++ptr) {
+        if(digits < CONVERT_MAX_DIGITS) {
+            mantissa = mantissa * 10 + (*ptr - '0');
+            digits += 1;
+        } else {
+            truncated |= *ptr != '0';
+            exponent += 1;
+        }
+    }
+    
+    if(ptr != end && *ptr == '.') {
+        ptr++;
+        if(!digits) {
+            while(ptr != end && *ptr == '0') {
+                exponent -= 1;
+                ptr++;
+            }
+        }
+        for(; ptr != end && *ptr >= '0' && *ptr <= '9'; ++ptr) {
+            if(digits < CONVERT_MAX_DIGITS) {
+                mantissa = mantissa * 10 + (*ptr - '0');
+                exponent -= 1;
+                digits += 1;
+            } else {
+                truncated |= *ptr != '0';
+            }
+        }
+    }
+    
+    if(ptr != end && (*ptr == 'e' || *ptr == 'E' || *ptr == 'd' || *ptr == 'D')) {
+        ptr++;
+        bool exp_negative = false;
+        if(ptr != end && (*ptr == '-' || *ptr == '+')) {
+            exp_negative = *ptr == '-';
+            ptr++;
+        }
+        int64_t exp_value = 0;
+        for(; ptr != end && *ptr >= '0' && *ptr <= '9'; ++ptr) {
+            // Anything past this is infinity or zero anyway, so there's no need to keep counting.
+            if(exp_value < 100000) exp_value = exp_value * 10 + (*ptr - '0');
+        }
+        exponent += exp_negative ? -exp_value : exp_value;
+    }
+    
+    double value;
+    if(!truncated && convert_fast_double(negative, mantissa, exponent, &value)) return value;
+    return convert_slow_double(start, length);
+}
+
+// MARK: - Integer conversion
+
+// Reads eight bytes in memory order into the low-to-high bytes of a word.
+static inline uint64_t load_eight(const char* ptr) {
+    uint64_t word;
+    memcpy(&word, ptr, sizeof(word));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    word = __builtin_bswap64(word);
+#endif
+    return word;
+}
+
+// SWAR (SIMD within a register) digit parsing: checks and converts eight ASCII digits at once.
+static inline bool is_eight_digits(uint64_t word) {
+    return ((word & UINT64_C(0xf0f0f0f0f0f0f0f0))
+         | (((word + UINT64_C(0x0606060606060606)) & UINT64_C(0xf0f0f0f0f0f0f0f0)) >> 4))
+         == UINT64_C(0x3333333333333333);
+}
+
+static inline uint32_t parse_eight_digits(uint64_t word) {
+    const uint64_t mask = UINT64_C(0x000000ff000000ff);
+    const uint64_t mul1 = UINT64_C(100) + (UINT64_C(1000000) << 32);
+    const uint64_t mul2 = UINT64_C(1) + (UINT64_C(10000) << 32);
+    word -= UINT64_C(0x3030303030303030);
+    word = (word * 10) + (word >> 8);
+    return (uint32_t)((((word & mask) * mul1) + (((word >> 16) & mask) * mul2)) >> 32);
+}
+
+// Parses the unsigned decimal digits in [ptr, end). At most 20 digits fit in 64 bits: the first 16
+// are done eight at a time (and can't overflow), and only the last four need checking.
+static parsec_result parse_digits(const char* ptr, const char* end, uint64_t* out) {
+    if(ptr == end) return PARSEC_INVALID;
+    while(ptr != end && *ptr == '0') ptr++;
+    
+    uint64_t value = 0;
+    int blocks = 0;
+    while(end - ptr >= 8 && blocks < 2) {
+        uint64_t word = load_eight(ptr);
+        if(!is_eight_digits(word)) break;
+        value = value * 100000000 + parse_eight_digits(word);
+        ptr += 8;
+        blocks += 1;
+    }
+    
+    bool overflow = false;
+    for(; ptr != end; ++ptr) {
+        if(*ptr < '0' || *ptr > '9') return PARSEC_INVALID;
+        uint64_t digit = *ptr - '0';
+        if(value > (UINT64_MAX - digit) / 10) overflow = true;
+        value = value * 10 + digit;
+    }
+    if(overflow) return PARSEC_OVERFLOW;
+    *out = value;
+    return PARSEC_SUCCESS;
+}
+
+parsec_result parsec_str_uint64(const char* ptr, parsec_idx length, uint64_t* value) {
+    const char* end = ptr + length;
+    if(ptr != end && *ptr == '+') ptr++;
+    return parse_digits(ptr, end, value);
+}
+
+parsec_result parsec_str_int64(const char* ptr, parsec_idx length, int64_t* value) {
+    const char* end = ptr + length;
+    bool negative = false;
+    if(ptr != end && (*ptr == '-' || *ptr == '+')) {
+        negative = *ptr == '-';
+        ptr++;
+    }
+    
+    uint64_t magnitude;
+    parsec_result result = parse_digits(ptr, end, &magnitude);
+    if(result != PARSEC_SUCCESS) return result;
+    
+    uint64_t limit = negative ? (uint64_t)INT64_MAX + 1 : (uint64_t)INT64_MAX;
+    if(magnitude > limit) return PARSEC_OVERFLOW;
+    *value = negative ? (int64_t)(0 - magnitude) : (int64_t)magnitude;
+    return PARSEC_SUCCESS;
+}
+
+// Out-of-range values are clamped, like the integers parsec_lex_values converts.
+int32_t parsec_str_int(const char* ptr, parsec_idx length) {
+    int64_t value;
+    parsec_result result = parsec_str_int64(ptr, length, &value);
+    if(result == PARSEC_OVERFLOW) return length && *ptr == '-' ? INT32_MIN : INT32_MAX;
+    if(result != PARSEC_SUCCESS) return 0;
+    if(value < INT32_MIN) return INT32_MIN;
+    if(value > INT32_MAX) return INT32_MAX;
+    return (int32_t)value;
+}
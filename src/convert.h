@@ -0,0 +1,25 @@
+//===--------------------------------------------------------------------------------------------===
+// convert.h - Conversion of numeric tokens to their values
+// This source is part of ParseC
+//
+// Copyright (c) 2018 Amy Parent <amy@amyparent.com>
+// Licensed under the MIT License
+// =^•.•^=
+//===--------------------------------------------------------------------------------------------===
+#ifndef _PARSEC_CONVERT_
+#define _PARSEC_CONVERT_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// The number of decimal digits that always fit in a uint64_t.
+#define CONVERT_MAX_DIGITS  19
+
+// Computes [mantissa] * 10^[exponent] into [out] when the result can be computed exactly with
+// double arithmetic, and returns whether it could.
+bool convert_fast_double(bool negative, uint64_t mantissa, int64_t exponent, double* out);
+
+// Converts the decimal number in [ptr, ptr+length) the slow (but correctly rounded) way.
+double convert_slow_double(const char* ptr, uint64_t length);
+
+#endif /* _PARSEC_CONVERT_ */
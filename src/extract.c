@@ -0,0 +1,137 @@
+//===--------------------------------------------------------------------------------------------===
+// extract.c - Schema-driven extraction of records into columns
+// This source is part of ParseC
+//
+// Copyright (c) 2018 Amy Parent <amy@amyparent.com>
+// Licensed under the MIT License
+// =^•.•^=
+//===--------------------------------------------------------------------------------------------===
+#include "scan.h"
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <parsec/parsec.h>
+
+static inline bool is_line_end(const parsec_token* token) {
+    return token->kind == PARSEC_TOKEN_NEWLINE || token->kind == PARSEC_TOKEN_COMMENT;
+}
+
+// Moves past the end of the current line, after an error or on a line we aren't interested in.
+static void skip_record(parsec* parser) {
+    parser->head = scan_newline(parser->head, parser->end);
+    if(parser->head < parser->end) parser->head += 1;
+}
+
+static bool store_field(const parsec_column* column, uint64_t row,
+                        const parsec_token* token, const parsec_value* value) {
+    switch(column->type) {
+    case PARSEC_FIELD_INT:
+        if(token->kind != PARSEC_TOKEN_INT) return false;
+        // Values that didn't fit were clamped, and only the limits themselves need checking again.
+        if(value->integer == INT64_MAX || value->integer == INT64_MIN) {
+            int64_t checked;
+            if(parsec_str_int64(token->start, token->length, &checked) != PARSEC_SUCCESS) return false;
+        }
+        ((int64_t*)column->data)[row] = value->integer;
+        return true;
+        
+    case PARSEC_FIELD_FLOAT:
+        if(token->kind == PARSEC_TOKEN_INT) {
+            // A double can hold integers an int64_t can't, but not once they've been clamped.
+            double real = (double)value->integer;
+            if(value->integer == INT64_MAX || value->integer == INT64_MIN) {
+                int64_t checked;
+                if(parsec_str_int64(token->start, token->length, &checked) != PARSEC_SUCCESS) {
+                    real = parsec_str_double(token->start, token->length);
+                }
+            }
+            ((double*)column->data)[row] = real;
+        } else if(token->kind == PARSEC_TOKEN_FLOAT) ((double*)column->data)[row] = value->real;
+        else return false;
+        return true;
+        
+    case PARSEC_FIELD_STRING:
+    case PARSEC_FIELD_KEY:
+        if(token->kind != (column->type == PARSEC_FIELD_STRING ? PARSEC_TOKEN_STRING : PARSEC_TOKEN_KEY)) {
+            return false;
+        }
+        ((parsec_token*)column->data)[row] = *token;
+        return true;
+    }
+    return false;
+}
+
+// Extracts the fields of one record, whose keyword was just lexed. Returns whether the record
+// matched [schema]; the parser is left at the start of the next line either way.
+static bool extract_record(parsec* parser, parsec_schema* schema) {
+    parsec_token token;
+    parsec_value value;
+    
+    for(uint32_t i = 0; i < schema->column_count; ++i) {
+        parsec_result result = parsec_next_value(parser, &token, &value);
+        if(result == 0) return false;
+        if(result < 0 || is_line_end(&token) || !store_field(&schema->columns[i], schema->rows, &token, &value)) {
+            if(result < 0 || token.kind != PARSEC_TOKEN_NEWLINE) skip_record(parser);
+            return false;
+        }
+    }
+    
+    // The record has to end right after its last field.
+    parsec_result result = parsec_next(parser, &token);
+    if(result == 0 || (result > 0 && token.kind == PARSEC_TOKEN_NEWLINE)) return true;
+    skip_record(parser);
+    return result > 0 && token.kind == PARSEC_TOKEN_COMMENT;
+}
+
+parsec_result parsec_extract(parsec* parser, parsec_schema* schemas, uint32_t schema_count) {
+    assert(parser && "Invalid ParseC status given");
+    assert((schemas || !schema_count) && "Invalid schemas given");
+    
+    // Records are dispatched on their keyword, with a table made of the schemas' keywords.
+    const char** words = malloc((schema_count ? schema_count : 1) * sizeof(const char*));
+    if(!words) return PARSEC_NOALLOC;
+    for(uint32_t i = 0; i < schema_count; ++i) words[i] = schemas[i].keyword;
+    
+    parsec_keywords keywords;
+    parsec_result result = parsec_keywords_init(&keywords, words, schema_count);
+    if(result != PARSEC_SUCCESS) {
+        free(words);
+        return result;
+    }
+    const parsec_keywords* previous = parser->keywords;
+    parser->keywords = &keywords;
+    
+    uint64_t rows = 0;
+    for(;;) {
+        const char* start = parser->head;
+        parsec_token token;
+        parsec_result next = parsec_next(parser, &token);
+        if(next == 0) break;
+        if(next < 0 || token.kind != PARSEC_TOKEN_KEY || token.keyword == PARSEC_KEYWORD_UNKNOWN) {
+            if(next < 0 || token.kind != PARSEC_TOKEN_NEWLINE) skip_record(parser);
+            continue;
+        }
+        
+        parsec_schema* schema = &schemas[token.keyword];
+        if(schema->rows >= schema->capacity) {
+            parser->head = start;
+            result = PARSEC_NOMEM;
+            break;
+        }
+        
+        bool valid = extract_record(parser, schema);
+        if(schema->errors) {
+            uint8_t bit = 1 << (schema->rows & 7);
+            if(valid) schema->errors[schema->rows >> 3] &= ~bit;
+            else schema->errors[schema->rows >> 3] |= bit;
+        }
+        schema->rows += 1;
+        rows += 1;
+    }
+    
+    parser->keywords = previous;
+    parsec_keywords_deinit(&keywords);
+    free(words);
+    return result == PARSEC_SUCCESS ? (parsec_result)rows : result;
+}
@@ -0,0 +1,56 @@
+//===--------------------------------------------------------------------------------------------===
+// file.c - Memory-mapped file front-end for the lexer
+// This source is part of ParseC
+//
+// Copyright (c) 2018 Amy Parent <amy@amyparent.com>
+// Licensed under the MIT License
+// =^•.•^=
+//===--------------------------------------------------------------------------------------------===
+#include <assert.h>
+#include <stdbool.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <parsec/parsec.h>
+
+parsec_result parsec_open_file(parsec* parser, const char* path, char comment_char) {
+    assert(parser && "Invalid ParseC status given");
+    assert(path && "Invalid file path given");
+    
+    int fd = open(path, O_RDONLY);
+    if(fd < 0) return PARSEC_NOFILE;
+    
+    struct stat info;
+    if(fstat(fd, &info) != 0 || !S_ISREG(info.st_mode)) {
+        close(fd);
+        return PARSEC_NOFILE;
+    }
+    
+    // mmap can't map zero bytes, but an empty file is still a valid (empty) source.
+    if(info.st_size == 0) {
+        close(fd);
+        parsec_init(parser, "", 0, comment_char);
+        return PARSEC_SUCCESS;
+    }
+    
+    uint64_t length = (uint64_t)info.st_size;
+    void* data = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    // The mapping keeps its own reference to the file.
+    close(fd);
+    if(data == MAP_FAILED) return PARSEC_NOFILE;
+    
+    // The lexer only ever moves forward, so let the kernel read ahead aggressively. These are
+    // only hints: failing to apply them isn't an error.
+    madvise(data, length, MADV_SEQUENTIAL);
+    madvise(data, length, MADV_WILLNEED);
+    
+    parsec_init(parser, data, length, comment_char);
+    return PARSEC_SUCCESS;
+}
+
+void parsec_close_file(parsec* parser) {
+    assert(parser && "Invalid ParseC status given");
+    if(parser->end > parser->data) munmap((void*)parser->data, parser->end - parser->data);
+    parser->data = parser->head = parser->end = "";
+}
@@ -0,0 +1,193 @@
+//===--------------------------------------------------------------------------------------------===
+// index.c - Line offset index, for random access into large sources
+// This source is part of ParseC
+//
+// Copyright (c) 2018 Amy Parent <amy@amyparent.com>
+// Licensed under the MIT License
+// =^•.•^=
+//===--------------------------------------------------------------------------------------------===
+#include "scan.h"
+#include <assert.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <parsec/parsec.h>
+
+static const char index_magic[8] = { 'P', 'S', 'C', 'I', 'D', 'X', '0', '3' };
+
+// Loading an index has to cost much less than building one, so it isn't checked against a hash of
+// the whole source, but of INDEX_SAMPLES blocks spread evenly through it (and of all of it, when
+// it's smaller than that). Together with the length, and the line returns every offset must come
+// right after, that catches any source that was replaced or regenerated.
+#define INDEX_SAMPLES       64
+#define INDEX_SAMPLE_SIZE   256
+
+static uint64_t index_fingerprint(const char* data, uint64_t length) {
+    if(length <= INDEX_SAMPLES * INDEX_SAMPLE_SIZE) return parsec_hash(data, length);
+    uint64_t hash = length;
+    uint64_t stride = (length - INDEX_SAMPLE_SIZE) / (INDEX_SAMPLES - 1);
+    for(uint64_t i = 0; i < INDEX_SAMPLES; ++i) {
+        hash = hash * 0x9e3779b185ebca87ull + parsec_hash(data + i * stride, INDEX_SAMPLE_SIZE);
+    }
+    return hash;
+}
+
+static bool index_push(parsec_line_index* index, uint64_t* capacity, uint64_t offset) {
+    if(index->count == *capacity) {
+        uint64_t grown = *capacity ? *capacity * 2 : 1024;
+        uint64_t* lines = realloc(index->lines, grown * sizeof(uint64_t));
+        if(!lines) return false;
+        index->lines = lines;
+        *capacity = grown;
+    }
+    index->lines[index->count++] = offset;
+    return true;
+}
+
+parsec_result parsec_index_build(const parsec* parser, parsec_line_index* index) {
+    assert(parser && "Invalid ParseC status given");
+    assert(index && "Invalid line index given");
+    
+    index->lines = NULL;
+    index->count = 0;
+    index->length = parser->end - parser->data;
+    index->hash = index_fingerprint(parser->data, index->length);
+    
+    uint64_t capacity = 0;
+    const char* ptr = parser->data;
+    if(!index_push(index, &capacity, 0)) return PARSEC_NOALLOC;
+    while((ptr = scan_newline(ptr, parser->end)) < parser->end) {
+        ptr += 1;
+        if(!index_push(index, &capacity, ptr - parser->data)) {
+            parsec_index_deinit(index);
+            return PARSEC_NOALLOC;
+        }
+    }
+    return PARSEC_SUCCESS;
+}
+
+void parsec_index_deinit(parsec_line_index* index) {
+    assert(index && "Invalid line index given");
+    free(index->lines);
+    index->lines = NULL;
+    index->count = 0;
+}
+
+// Lookups and lexing trust the offsets, so a loaded index must start at 0, only move forward
+// through the source, and only ever land right after a line return.
+static bool index_valid(const uint64_t* lines, uint64_t count, const char* data, uint64_t length) {
+    if(lines[0] != 0) return false;
+    for(uint64_t i = 1; i < count; ++i) {
+        if(lines[i] <= lines[i - 1] || lines[i] > length || data[lines[i] - 1] != '\n') return false;
+    }
+    return true;
+}
+
+// The on-disk format is the magic number, the source length and fingerprint, the line count and the
+// offsets, all in native byte order: indices are meant to be kept next to their source, not
+// shipped around.
+parsec_result parsec_index_save(const parsec_line_index* index, const char* path) {
+    assert(index && "Invalid line index given");
+    FILE* file = fopen(path, "wb");
+    if(!file) return PARSEC_NOFILE;
+    
+    bool ok = fwrite(index_magic, sizeof(index_magic), 1, file) == 1
+           && fwrite(&index->length, sizeof(uint64_t), 1, file) == 1
+           && fwrite(&index->hash, sizeof(uint64_t), 1, file) == 1
+           && fwrite(&index->count, sizeof(uint64_t), 1, file) == 1
+           && fwrite(index->lines, sizeof(uint64_t), index->count, file) == index->count;
+    ok = fclose(file) == 0 && ok;
+    return ok ? PARSEC_SUCCESS : PARSEC_NOFILE;
+}
+
+parsec_result parsec_index_load(parsec_line_index* index, const char* path, const parsec* parser) {
+    assert(index && "Invalid line index given");
+    assert(parser && "Invalid ParseC status given");
+    
+    index->lines = NULL;
+    index->count = 0;
+    FILE* file = fopen(path, "rb");
+    if(!file) return PARSEC_NOFILE;
+    
+    char magic[sizeof(index_magic)];
+    uint64_t count;
+    parsec_result result = PARSEC_SUCCESS;
+    if(fread(magic, sizeof(magic), 1, file) != 1
+       || fread(&index->length, sizeof(uint64_t), 1, file) != 1
+       || fread(&index->hash, sizeof(uint64_t), 1, file) != 1
+       || fread(&count, sizeof(uint64_t), 1, file) != 1
+       || memcmp(magic, index_magic, sizeof(magic)) != 0
+       || index->length != (uint64_t)(parser->end - parser->data)
+       || count == 0 || count > index->length + 1
+       || index->hash != index_fingerprint(parser->data, index->length)) {
+        result = PARSEC_INVALID;
+    } else if(!(index->lines = malloc(count * sizeof(uint64_t)))) {
+        result = PARSEC_NOALLOC;
+    } else if(fread(index->lines, sizeof(uint64_t), count, file) != count
+              || !index_valid(index->lines, count, parser->data, index->length)) {
+        result = PARSEC_INVALID;
+    } else {
+        index->count = count;
+    }
+    
+    fclose(file);
+    if(result != PARSEC_SUCCESS) parsec_index_deinit(index);
+    return result;
+}
+
+uint64_t parsec_index_line_at(const parsec_line_index* index, uint64_t offset) {
+    assert(index && index->count && "Invalid line index given");
+    // Find the last line that starts at or before [offset].
+    uint64_t low = 0;
+    uint64_t high = index->count;
+    while(high - low > 1) {
+        uint64_t mid = low + (high - low) / 2;
+        if(index->lines[mid] <= offset) low = mid;
+        else high = mid;
+    }
+    return low;
+}
+
+void parsec_token_location(const parsec* parser, const parsec_line_index* index, const char* ptr,
+                           uint64_t* line, uint64_t* column) {
+    assert(parser && "Invalid ParseC status given");
+    assert(ptr >= parser->data && ptr <= parser->end && "Pointer outside of the source");
+    
+    uint64_t found = parsec_index_line_at(index, ptr - parser->data);
+    if(line) *line = found;
+    if(!column) return;
+    
+    // Every byte but UTF-8 continuation bytes starts a new codepoint.
+    uint64_t codepoints = 0;
+    for(const char* c = parser->data + index->lines[found]; c < ptr; ++c) {
+        if((*c & 0xc0) != 0x80) codepoints += 1;
+    }
+    *column = codepoints;
+}
+
+parsec_result parsec_seek_line(parsec* parser, const parsec_line_index* index, uint64_t line) {
+    assert(parser && "Invalid ParseC status given");
+    assert(index && "Invalid line index given");
+    if(line >= index->count) return PARSEC_INVALID;
+    parser->head = parser->data + index->lines[line];
+    return PARSEC_SUCCESS;
+}
+
+parsec_result parsec_lex_lines(parsec* parser, const parsec_line_index* index, uint64_t first,
+                               uint64_t count, parsec_token* tokens, uint64_t token_count) {
+    assert(parser && "Invalid ParseC status given");
+    assert(index && "Invalid line index given");
+    if(first >= index->count) return PARSEC_INVALID;
+    if(!count) return 0;
+    
+    // Lines end right after their line return, so every token in the range is complete.
+    const char* end = parser->end;
+    if(count < index->count - first) parser->end = parser->data + index->lines[first + count];
+    
+    parser->head = parser->data + index->lines[first];
+    parser->next_token = 0;
+    parsec_result result = parsec_lex(parser, tokens, token_count);
+    parser->end = end;
+    return result;
+}
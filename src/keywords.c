@@ -0,0 +1,112 @@
+//===--------------------------------------------------------------------------------------------===
+// keywords.c - Keyword tables with a perfect hash
+// This source is part of ParseC
+//
+// Copyright (c) 2018 Amy Parent <amy@amyparent.com>
+// Licensed under the MIT License
+// =^•.•^=
+//===--------------------------------------------------------------------------------------------===
+#include <assert.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <parsec/parsec.h>
+
+// How many seeds we try for a table size before giving up and doubling it.
+#define KEYWORDS_MAX_SEEDS  4096
+#define KEYWORDS_MAX_SLOTS  (1u << 20)
+
+// FNV-1a, starting from [seed] instead of the usual offset basis.
+static inline uint32_t keyword_hash(const char* str, parsec_idx length, uint32_t seed) {
+    uint32_t hash = seed ^ 0x811c9dc5;
+    for(parsec_idx i = 0; i < length; ++i) {
+        hash = (hash ^ (uint8_t)str[i]) * 0x01000193;
+    }
+    return hash ^ (hash >> 15);
+}
+
+// Tries to place every keyword in its own slot with [seed]. Returns whether there wasn't any collision.
+static bool keywords_place(parsec_keywords* keywords, uint32_t seed) {
+    for(uint32_t i = 0; i <= keywords->mask; ++i) keywords->slots[i] = PARSEC_KEYWORD_UNKNOWN;
+    for(uint32_t i = 0; i < keywords->count; ++i) {
+        uint32_t slot = keyword_hash(keywords->words[i], keywords->lengths[i], seed) & keywords->mask;
+        if(keywords->slots[slot] != PARSEC_KEYWORD_UNKNOWN) return false;
+        keywords->slots[slot] = (int32_t)i;
+    }
+    keywords->seed = seed;
+    return true;
+}
+
+static int keywords_compare(const void* a, const void* b) {
+    return strcmp(*(const char* const*)a, *(const char* const*)b);
+}
+
+// Duplicates would collide under every seed, and make us go through all of them at every table
+// size before failing, so they're caught up front: once sorted, they end up next to each other.
+static parsec_result keywords_check(const char* const* words, uint32_t count) {
+    if(count < 2) return PARSEC_SUCCESS;
+    const char** sorted = malloc(count * sizeof(const char*));
+    if(!sorted) return PARSEC_NOALLOC;
+    memcpy(sorted, words, count * sizeof(const char*));
+    qsort(sorted, count, sizeof(const char*), keywords_compare);
+    
+    parsec_result result = PARSEC_SUCCESS;
+    for(uint32_t i = 1; i < count && result == PARSEC_SUCCESS; ++i) {
+        if(strcmp(sorted[i - 1], sorted[i]) == 0) result = PARSEC_INVALID;
+    }
+    free(sorted);
+    return result;
+}
+
+parsec_result parsec_keywords_init(parsec_keywords* keywords, const char* const* words, uint32_t count) {
+    assert(keywords && "Invalid keyword table given");
+    assert((words || !count) && "Invalid keywords given");
+    
+    keywords->words = words;
+    keywords->count = count;
+    keywords->slots = NULL;
+    keywords->lengths = NULL;
+    parsec_result result = keywords_check(words, count);
+    if(result != PARSEC_SUCCESS) return result;
+    
+    keywords->lengths = malloc((count ? count : 1) * sizeof(parsec_idx));
+    if(!keywords->lengths) return PARSEC_NOALLOC;
+    for(uint32_t i = 0; i < count; ++i) keywords->lengths[i] = strlen(words[i]);
+    
+    // Start with a table that's at most half full, and grow it until a seed works.
+    uint32_t slots = 2;
+    while(slots < count * 2) slots *= 2;
+    for(; slots <= KEYWORDS_MAX_SLOTS; slots *= 2) {
+        int32_t* table = realloc(keywords->slots, slots * sizeof(int32_t));
+        if(!table) break;
+        keywords->slots = table;
+        keywords->mask = slots - 1;
+        for(uint32_t seed = 0; seed < KEYWORDS_MAX_SEEDS; ++seed) {
+            if(keywords_place(keywords, seed)) return PARSEC_SUCCESS;
+        }
+    }
+    
+    result = keywords->slots ? PARSEC_INVALID : PARSEC_NOALLOC;
+    parsec_keywords_deinit(keywords);
+    return result;
+}
+
+void parsec_keywords_deinit(parsec_keywords* keywords) {
+    assert(keywords && "Invalid keyword table given");
+    free(keywords->lengths);
+    free(keywords->slots);
+    keywords->lengths = NULL;
+    keywords->slots = NULL;
+    keywords->count = 0;
+}
+
+int32_t parsec_keywords_find(const parsec_keywords* keywords, const char* str, parsec_idx length) {
+    assert(keywords && "Invalid keyword table given");
+    uint32_t slot = keyword_hash(str, length, keywords->seed) & keywords->mask;
+    int32_t id = keywords->slots[slot];
+    if(id == PARSEC_KEYWORD_UNKNOWN) return id;
+    if(keywords->lengths[id] != length || memcmp(keywords->words[id], str, length) != 0) {
+        return PARSEC_KEYWORD_UNKNOWN;
+    }
+    return id;
+}
@@ -0,0 +1,200 @@
+//===--------------------------------------------------------------------------------------------===
+// parallel.c - Multi-threaded lexing of a single buffer
+// This source is part of ParseC
+//
+// Copyright (c) 2018 Amy Parent <amy@amyparent.com>
+// Licensed under the MIT License
+// =^•.•^=
+//===--------------------------------------------------------------------------------------------===
+#include "parallel.h"
+#include <assert.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <parsec/parsec.h>
+
+void* parallel_lex(void* data) {
+    parallel_job* job = data;
+    if(job->capacity) {
+        job->result = parsec_lex(&job->parser, job->tokens, job->capacity);
+        if(job->result != PARSEC_NOMEM) return NULL;
+    }
+    
+    uint64_t capacity = job->parser.next_token + (job->parser.end - job->parser.head) / 4 + 16;
+    for(;;) {
+        parsec_token* tokens = job->owned ? realloc(job->tokens, capacity * sizeof(parsec_token))
+                                          : malloc(capacity * sizeof(parsec_token));
+        if(!tokens) {
+            job->result = PARSEC_NOALLOC;
+            return NULL;
+        }
+        if(!job->owned) memcpy(tokens, job->tokens, job->parser.next_token * sizeof(parsec_token));
+        job->tokens = tokens;
+        job->capacity = capacity;
+        job->owned = true;
+        // parsec_lex picks up from parser.next_token, so nothing is lexed twice
+        job->result = parsec_lex(&job->parser, job->tokens, job->capacity);
+        if(job->result != PARSEC_NOMEM) return NULL;
+        capacity *= 2;
+    }
+}
+
+unsigned parallel_split(const parsec* parser, parallel_job* jobs, unsigned count) {
+    const char* start = parser->head;
+    const char* end = parser->end;
+    uint64_t size = (end - start) / count;
+    unsigned chunks = 0;
+    
+    while(start < end) {
+        const char* cut = end;
+        if(chunks + 1 < count && (uint64_t)(end - start) > size) {
+            cut = memchr(start + size, '\n', end - start - size);
+            cut = cut ? cut + 1 : end;
+        }
+        parallel_job* job = &jobs[chunks++];
+        job->parser = *parser;
+        job->parser.head = start;
+        job->parser.end = cut;
+        job->parser.next_token = 0;
+#ifdef PARSEC_STATS
+        parsec_stats_reset(&job->parser);
+#endif
+        job->tokens = NULL;
+        job->capacity = 0;
+        job->owned = false;
+        job->result = PARSEC_SUCCESS;
+        start = cut;
+    }
+    return chunks;
+}
+
+// Each chunk is lent the range of [tokens] its tokens would end up in if the input was evenly
+// dense, as parsec_estimate_tokens assumes: the room left is split in proportion to chunk sizes.
+static void parallel_lend(const parsec* parser, parsec_token* tokens, uint64_t token_count,
+                          parallel_job* jobs, unsigned chunks) {
+    uint64_t room = token_count - parser->next_token;
+    double size = (double)(parser->end - parser->head);
+    uint64_t start = parser->next_token;
+    for(unsigned i = 0; i < chunks; ++i) {
+        uint64_t end = token_count;
+        if(i + 1 < chunks) {
+            end = parser->next_token + (uint64_t)(room * ((jobs[i].parser.end - parser->head) / size));
+            if(end > token_count) end = token_count;
+            if(end < start) end = start;
+        }
+        jobs[i].tokens = tokens + start;
+        jobs[i].capacity = end - start;
+        start = end;
+    }
+}
+
+// Packs the chunks' tokens together, stopping at the first one that didn't lex cleanly so the
+// parser ends up in the same state as after a sequential parsec_lex. Chunks that stayed in their
+// range only move down, but one that overflowed can take up the start of the ranges after it:
+// those are copied out of the way first.
+static parsec_result parallel_stitch(parsec* parser, parsec_token* tokens, uint64_t token_count,
+                                     parallel_job* jobs, unsigned chunks) {
+    uint64_t next = parser->next_token;
+    for(unsigned i = 0; i < chunks && next <= token_count; ++i) {
+        parallel_job* job = &jobs[i];
+        uint64_t count = job->parser.next_token;
+        if(!job->owned && count && job->tokens < tokens + next) {
+            parsec_token* copy = malloc(count * sizeof(parsec_token));
+            if(copy) {
+                memcpy(copy, job->tokens, count * sizeof(parsec_token));
+                job->tokens = copy;
+                job->owned = true;
+            } else {
+                // Then nothing of this chunk can be kept, as if it couldn't be lexed at all.
+                job->parser.next_token = 0;
+                job->parser.head = jobs[i - 1].parser.end;
+                job->result = PARSEC_NOALLOC;
+            }
+        }
+        if(job->result < 0) break;
+        next += job->parser.next_token;
+    }
+    
+    parsec_result result = PARSEC_SUCCESS;
+    for(unsigned i = 0; i < chunks && result == PARSEC_SUCCESS; ++i) {
+        parallel_job* job = &jobs[i];
+        uint64_t count = job->parser.next_token;
+        uint64_t room = token_count - parser->next_token;
+        if(count > room) {
+            if(room == count - 1 && job->result == PARSEC_INVALID) {
+                // The slot of an invalid token is never filled in, and the chunk's head is where
+                // the token failed, not where it starts. Lexing on from the token before it, with
+                // no room at all, stops right on it, like parsec_lex would have.
+                parsec probe = job->parser;
+                const parsec_token* last = room ? &job->tokens[room - 1] : NULL;
+                probe.head = last ? last->start + last->length : parser->head;
+                probe.next_token = 0;
+                parsec_lex(&probe, NULL, 0);
+                parser->head = probe.head;
+            } else {
+                parser->head = job->tokens[room].start;
+            }
+            memmove(tokens + parser->next_token, job->tokens, room * sizeof(parsec_token));
+            parser->next_token += room;
+            result = PARSEC_NOMEM;
+            break;
+        }
+        
+        memmove(tokens + parser->next_token, job->tokens, count * sizeof(parsec_token));
+        parser->next_token += count;
+        parser->head = job->parser.head;
+        if(job->result < 0) result = job->result;
+    }
+    return result;
+}
+
+parsec_result parsec_lex_parallel(parsec* parser, parsec_token* tokens, uint64_t token_count,
+                                  unsigned thread_count) {
+    assert(parser && "Invalid ParseC status given");
+    
+    if(!thread_count) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        thread_count = cpus > 0 ? (unsigned)cpus : 1;
+    }
+    uint64_t max_chunks = (parser->end - parser->head) / PARALLEL_MIN_CHUNK;
+    if(thread_count > max_chunks) thread_count = max_chunks;
+    if(thread_count < 2) return parsec_lex(parser, tokens, token_count);
+    
+    parallel_job* jobs = calloc(thread_count, sizeof(parallel_job));
+    pthread_t* threads = calloc(thread_count, sizeof(pthread_t));
+    bool* started = calloc(thread_count, sizeof(bool));
+    if(!jobs || !threads || !started) {
+        free(jobs);
+        free(threads);
+        free(started);
+        return PARSEC_NOALLOC;
+    }
+    
+    unsigned chunks = parallel_split(parser, jobs, thread_count);
+    parallel_lend(parser, tokens, token_count, jobs, chunks);
+    
+    // The calling thread takes the first chunk, and helps out with any chunk whose thread could
+    // not be started.
+    for(unsigned i = 1; i < chunks; ++i) {
+        started[i] = pthread_create(&threads[i], NULL, parallel_lex, &jobs[i]) == 0;
+    }
+    parallel_lex(&jobs[0]);
+    for(unsigned i = 1; i < chunks; ++i) {
+        if(started[i]) pthread_join(threads[i], NULL);
+        else parallel_lex(&jobs[i]);
+    }
+    
+    parsec_result result = parallel_stitch(parser, tokens, token_count, jobs, chunks);
+#ifdef PARSEC_STATS
+    for(unsigned i = 0; i < chunks; ++i) parsec_stats_merge(&parser->stats, &jobs[i].parser.stats);
+#endif
+    for(unsigned i = 0; i < chunks; ++i) {
+        if(jobs[i].owned) free(jobs[i].tokens);
+    }
+    free(jobs);
+    free(threads);
+    free(started);
+    return result == PARSEC_SUCCESS ? parser->next_token : result;
+}
@@ -0,0 +1,36 @@
+//===--------------------------------------------------------------------------------------------===
+// parallel.h - Line-aligned chunks of input lexed on their own threads
+// This source is part of ParseC
+//
+// Copyright (c) 2018 Amy Parent <amy@amyparent.com>
+// Licensed under the MIT License
+// =^•.•^=
+//===--------------------------------------------------------------------------------------------===
+#ifndef _PARSEC_PARALLEL_
+#define _PARSEC_PARALLEL_
+
+#include <stdbool.h>
+#include <parsec/parsec.h>
+
+// Below this, spinning up a thread costs more than lexing the chunk would.
+#define PARALLEL_MIN_CHUNK  (256 * 1024)
+
+// [tokens] is either lent to the job (a range of the caller's array), or [owned] by it.
+typedef struct {
+    parsec          parser;
+    parsec_token*   tokens;
+    uint64_t        capacity;
+    bool            owned;
+    parsec_result   result;
+} parallel_job;
+
+// Lexes a chunk into the [capacity] tokens lent to it, if any. When they run out, the tokens move
+// to an array of the job's own, which grows until the whole chunk fits. [data] is a parallel_job,
+// so this can be passed straight to pthread_create.
+void* parallel_lex(void* data);
+
+// Cuts the rest of [parser]'s input into at most [count] chunks that each end right after a line
+// return, so no token can straddle two chunks. Returns the number of chunks.
+unsigned parallel_split(const parsec* parser, parallel_job* jobs, unsigned count);
+
+#endif /* _PARSEC_PARALLEL_ */
@@ -8,106 +8,195 @@
 // =^•.•^=
 //===--------------------------------------------------------------------------------------------===
 #include "utf8.h"
-#include <math.h>
+#include "scan.h"
+#include "convert.h"
+#include "stats.h"
+#include "number_dfa.h"
 #include <assert.h>
 #include <string.h>
 #include <parsec/parsec.h>
 
+#if NUMBER_DIALECT_COUNT != PARSEC_DIALECT_COUNT
+#error "number_dfa.h is out of date with parsec_dialect: rerun parsec_numgen"
+#endif
+
+// MARK: - byte classes
+
+// Most input is plain ASCII, so every byte below 0x80 is classified with a single table lookup.
+// Bytes above that are the start (or middle) of a multibyte sequence, and go through the UTF-8
+// decoder instead. The comment character is set at runtime, and is checked separately.
+enum {
+    CHAR_SPACE          = 1 << 0,   // whitespace skipped between tokens (everything but '\n')
+    CHAR_NEWLINE        = 1 << 1,
+    CHAR_IDENT_HEAD     = 1 << 2,
+    CHAR_IDENT          = 1 << 3,
+    CHAR_DIGIT          = 1 << 4,
+    CHAR_NUMBER         = 1 << 5,   // anything a number can start with: sign, point or digit
+    CHAR_QUOTE          = 1 << 6,
+    CHAR_MARKER         = 1 << 7,
+};
+
+#define CHAR_ALPHA          (CHAR_IDENT_HEAD | CHAR_IDENT)
+#define CHAR_NUM            (CHAR_DIGIT | CHAR_IDENT | CHAR_NUMBER)
+#define CHAR_TERMINATOR     (CHAR_SPACE | CHAR_NEWLINE)
+
+static const uint8_t char_classes[256] = {
+    ['\0'] = CHAR_SPACE,   ['\t'] = CHAR_SPACE,   ['\v'] = CHAR_SPACE,
+    ['\f'] = CHAR_SPACE,   ['\r'] = CHAR_SPACE,   [' ']  = CHAR_SPACE,
+    ['\n'] = CHAR_NEWLINE,
+    ['\''] = CHAR_QUOTE,   ['@']  = CHAR_MARKER,
+    ['+']  = CHAR_NUMBER,  ['-']  = CHAR_NUMBER,  ['.']  = CHAR_NUMBER,
+    ['0']  = CHAR_NUM,     ['1']  = CHAR_NUM,     ['2']  = CHAR_NUM,     ['3']  = CHAR_NUM,
+    ['4']  = CHAR_NUM,     ['5']  = CHAR_NUM,     ['6']  = CHAR_NUM,     ['7']  = CHAR_NUM,
+    ['8']  = CHAR_NUM,     ['9']  = CHAR_NUM,
+    ['_']  = CHAR_ALPHA,
+    ['a']  = CHAR_ALPHA,   ['b']  = CHAR_ALPHA,   ['c']  = CHAR_ALPHA,   ['d']  = CHAR_ALPHA,
+    ['e']  = CHAR_ALPHA,   ['f']  = CHAR_ALPHA,   ['g']  = CHAR_ALPHA,   ['h']  = CHAR_ALPHA,
+    ['i']  = CHAR_ALPHA,   ['j']  = CHAR_ALPHA,   ['k']  = CHAR_ALPHA,   ['l']  = CHAR_ALPHA,
+    ['m']  = CHAR_ALPHA,   ['n']  = CHAR_ALPHA,   ['o']  = CHAR_ALPHA,   ['p']  = CHAR_ALPHA,
+    ['q']  = CHAR_ALPHA,   ['r']  = CHAR_ALPHA,   ['s']  = CHAR_ALPHA,   ['t']  = CHAR_ALPHA,
+    ['u']  = CHAR_ALPHA,   ['v']  = CHAR_ALPHA,   ['w']  = CHAR_ALPHA,   ['x']  = CHAR_ALPHA,
+    ['y']  = CHAR_ALPHA,   ['z']  = CHAR_ALPHA,
+    ['A']  = CHAR_ALPHA,   ['B']  = CHAR_ALPHA,   ['C']  = CHAR_ALPHA,   ['D']  = CHAR_ALPHA,
+    ['E']  = CHAR_ALPHA,   ['F']  = CHAR_ALPHA,   ['G']  = CHAR_ALPHA,   ['H']  = CHAR_ALPHA,
+    ['I']  = CHAR_ALPHA,   ['J']  = CHAR_ALPHA,   ['K']  = CHAR_ALPHA,   ['L']  = CHAR_ALPHA,
+    ['M']  = CHAR_ALPHA,   ['N']  = CHAR_ALPHA,   ['O']  = CHAR_ALPHA,   ['P']  = CHAR_ALPHA,
+    ['Q']  = CHAR_ALPHA,   ['R']  = CHAR_ALPHA,   ['S']  = CHAR_ALPHA,   ['T']  = CHAR_ALPHA,
+    ['U']  = CHAR_ALPHA,   ['V']  = CHAR_ALPHA,   ['W']  = CHAR_ALPHA,   ['X']  = CHAR_ALPHA,
+    ['Y']  = CHAR_ALPHA,   ['Z']  = CHAR_ALPHA,
+};
+
+// Returns the class of [c], or 0 for anything outside of ASCII (including invalid codepoints).
+static inline uint8_t classify(codepoint_t c) {
+    return (c >= 0 && c < 0x80) ? char_classes[c] : 0;
+}
+
 // MARK: - parser helping tools
 
+// Past the end of the buffer, we read a virtual NUL (whitespace) so tokens that end with the input
+// are terminated properly, without ever reading outside of [data, end).
 static inline codepoint_t current(const parsec* parser) {
-    uint64_t remaining = parser->end - parser->head;
-    return utf8_getCodepoint(parser->head, remaining);
+    if(parser->head >= parser->end) return 0;
+    uint8_t byte = (uint8_t)*parser->head;
+    if(byte < 0x80) return byte;
+    if(parser->validated) return utf8_decodeValid(parser->head);
+    return utf8_getCodepoint(parser->head, parser->end - parser->head);
 }
 
 static inline bool end(const parsec* parser) {
-    return (parser->head + utf8_codepointSize(current(parser))) >= parser->end;
+    return parser->head >= parser->end;
 }
 
 static inline codepoint_t next_char(parsec* parser) {
-    codepoint_t c = current(parser);
-    int8_t length = utf8_codepointSize(c);
-    if(length > 0) parser->head += length;
+    if(end(parser)) return 0;
+    if((uint8_t)*parser->head < 0x80) {
+        parser->head += 1;
+    } else if(parser->validated) {
+        parser->head += utf8_leadSize((uint8_t)*parser->head);
+        STAT_NON_ASCII(parser);
+    } else {
+        // Invalid sequences are stepped over one byte at a time, so we always make progress
+        int8_t length = utf8_codepointSize(current(parser));
+        parser->head += length > 0 ? length : 1;
+        STAT_NON_ASCII(parser);
+    }
     return current(parser);
 }
 
-typedef enum {
-    STATE_SIGN,
-    STATE_INTEGRAL,
-    STATE_POINT,
-    STATE_DECIMAL,
-    STATE_E,
-    STATE_ES,
-    STATE_EXPONENT
-} private_numstate;
+// What we need to compute the value of a number while lexing it: the same decomposition as
+// parsec_str_double uses, of up to CONVERT_MAX_DIGITS significant digits and a power of ten.
+typedef struct {
+    uint64_t    mantissa;
+    int64_t     exponent;
+    int64_t     exp_value;
+    int         digits;
+    bool        negative;
+    bool        exp_negative;
+    bool        truncated;
+} private_numvalue;
 
-static bool parse_number(parsec* parser, parsec_token* token) {
+// Adds [c], which just moved the number state machine to [state], to [acc].
+static inline void accumulate(private_numvalue* acc, private_numstate state, codepoint_t c) {
+    if(c == '-') {
+        if(state == STATE_SIGN) acc->negative = true;
+        else acc->exp_negative = true;
+        return;
+    }
+    if(!(classify(c) & CHAR_DIGIT)) return;
     
-    codepoint_t c = current(parser);
+    uint64_t digit = c - '0';
+    if(state == STATE_EXPONENT) {
+        // Anything past this is infinity or zero anyway, so there's no need to keep counting.
+        if(acc->exp_value < 100000) acc->exp_value = acc->exp_value * 10 + digit;
+    } else if(acc->digits < CONVERT_MAX_DIGITS) {
+        // Leading zeroes don't count towards the significant digits we can keep
+        if(acc->mantissa || digit) {
+            acc->mantissa = acc->mantissa * 10 + digit;
+            acc->digits += 1;
+        }
+        if(state == STATE_DECIMAL) acc->exponent -= 1;
+    } else {
+        if(state == STATE_INTEGRAL) acc->exponent += 1;
+        acc->truncated |= digit != 0;
+    }
+}
+
+static void number_value(const parsec_token* token, const private_numvalue* acc, parsec_value* value) {
+    if(token->kind == PARSEC_TOKEN_INT) {
+        // Integers that don't fit are clamped: parsec_str_int64 can tell them apart.
+        uint64_t limit = acc->negative ? (uint64_t)INT64_MAX + 1 : (uint64_t)INT64_MAX;
+        uint64_t magnitude = acc->truncated || acc->exponent || acc->mantissa > limit ? limit : acc->mantissa;
+        value->integer = acc->negative ? (int64_t)(0 - magnitude) : (int64_t)magnitude;
+        return;
+    }
+    int64_t exponent = acc->exponent + (acc->exp_negative ? -acc->exp_value : acc->exp_value);
+    if(acc->truncated || !convert_fast_double(acc->negative, acc->mantissa, exponent, &value->real)) {
+        value->real = convert_slow_double(token->start, token->length);
+    }
+}
+
+// Numbers only ever contain ASCII, so the DFA runs on bytes: anything else (including the first
+// byte of a multibyte sequence) is in NUMCLASS_OTHER, and ends the number as invalid. Past the end
+// of the input, it reads a terminator, like current() does.
+static bool parse_number(parsec* parser, parsec_token* token, parsec_value* value) {
+    const uint8_t* classes = number_classes[parser->dialect];
     token->start = parser->head;
-    private_numstate state = (c == '+' || c == '-') ? STATE_SIGN : STATE_INTEGRAL;
+    private_numstate state = STATE_START;
+    private_numvalue acc = { 0 };
     
     for(;;) {
-        c = next_char(parser);
+        uint8_t c = parser->head < parser->end ? (uint8_t)*parser->head : 0;
+        uint8_t cls = classes[c];
+        state = number_transitions[state][cls];
+        if(state >= STATE_FINAL) break;
+        if(value) accumulate(&acc, state, c);
+        parser->head += 1;
         
-        switch (state) {
-        case STATE_SIGN:
-            if(c >= '0' && c <= '9')                                state = STATE_INTEGRAL;
-            else if(c == '.')                                       state = STATE_POINT;
-            else                                                    return false;
-            
-        case STATE_INTEGRAL:
-            if(c >= '0' && c <= '9')                                state = STATE_INTEGRAL;
-            else if(c == '.')                                       state = STATE_POINT;
-            else if(c == 'e' || c == 'E' || c == 'd' || c == 'D')   state = STATE_E;
-            else if(utf8_isWhitespace(c))                           goto success;
-            else                                                    return false;
-            break;
-            
-        case STATE_POINT:
-            if(c >= '0' && c <= '9')                                state = STATE_DECIMAL;
-            else                                                    return false;
-            
-        case STATE_DECIMAL:
-            if(c >= '0' && c <= '9')                                state = STATE_DECIMAL;
-            else if(c == 'e' || c == 'E' || c == 'd' || c == 'D')   state = STATE_E;
-            else if(utf8_isWhitespace(c))                           goto success;
-            else                                                    return false;
-            
-            break;
-            
-        case STATE_E:
-            if(c == '+' || c == '-')                                state = STATE_ES;
-            else if(c >= '0' && c <= '9')                           state = STATE_EXPONENT;
-            else                                                    return false;
-            break;
-            
-        case STATE_ES:
-            if(c >= '0' && c <= '9')                                state = STATE_EXPONENT;
-            else                                                    return false;
-            
-        case STATE_EXPONENT:
-            if(c >= '0' && c <= '9')                                state = STATE_EXPONENT;
-            else if(utf8_isWhitespace(c))                           goto success;
-            else                                                    return false;
-            break;
+        // Digits never change the state they lead to, so whole runs can be taken in one go
+        if(cls != NUMCLASS_DIGIT) continue;
+        while(parser->head < parser->end && classes[(uint8_t)*parser->head] == NUMCLASS_DIGIT) {
+            if(value) accumulate(&acc, state, *parser->head);
+            parser->head += 1;
         }
     }
-    return false;
+    if(state == STATE_INVALID) return false;
     
-success:
-    token->kind = state == STATE_INTEGRAL ? PARSEC_TOKEN_INT : PARSEC_TOKEN_FLOAT;
+    token->kind = state == STATE_INT ? PARSEC_TOKEN_INT : PARSEC_TOKEN_FLOAT;
     token->length = parser->head - token->start;
+    if(value) number_value(token, &acc, value);
     return true;
 }
 
 static bool parse_key(parsec* parser, parsec_token* token) {
     token->start = parser->head;
-    codepoint_t c = next_char(parser);
+    next_char(parser);
     
     for(;;) {
-        if(!utf8_isIdentifier(c)) break;
-        c = next_char(parser);
+        while(!end(parser) && (char_classes[(uint8_t)*parser->head] & CHAR_IDENT)) parser->head += 1;
+        // Only non-ASCII characters need to go through the (slow) UTF-8 identifier ranges
+        if(end(parser) || (uint8_t)*parser->head < 0x80) break;
+        if(!utf8_isIdentifier(current(parser))) break;
+        next_char(parser);
     }
     token->kind = PARSEC_TOKEN_KEY;
     token->length = parser->head - token->start;
@@ -117,16 +206,26 @@ static bool parse_key(parsec* parser, parsec_token* token) {
 static bool parse_string(parsec* parser, parsec_token* token) {
     // First, we parse the initial quote
     token->start = parser->head;
-    codepoint_t c = next_char(parser);
+    parser->head += 1;
     
     for(;;) {
-        // We don't accept line returns in the middle of string tokens
-        if(c == '\n') return false;
+        parser->head = scan_string(parser->head, parser->end);
+        
+        // We don't accept line returns or unterminated strings
+        if(end(parser)) return false;
+        // Once the input is known to be valid, multibyte characters only need to be stepped over
+        if(parser->validated && (uint8_t)*parser->head >= 0x80) {
+            parser->head += utf8_leadSize((uint8_t)*parser->head);
+            STAT_NON_ASCII(parser);
+            continue;
+        }
+        codepoint_t c = current(parser);
+        if(c == '\n' || c < 0) return false;
         if(c == '\'') break;
-        c = next_char(parser);
+        next_char(parser);
     }
     // consume the closing quote
-    next_char(parser);
+    parser->head += 1;
     token->kind = PARSEC_TOKEN_STRING;
     token->length = parser->head - token->start;
     return true;
@@ -134,24 +233,112 @@ static bool parse_string(parsec* parser, parsec_token* token) {
 
 // MARK: - 
 
+static inline void skip_spaces(parsec* parser) {
+    // Most tokens are separated by a single space, which isn't worth calling into the scanner for
+    if(end(parser) || !(char_classes[(uint8_t)*parser->head] & CHAR_SPACE)) return;
+    parser->head += 1;
+    if(end(parser) || !(char_classes[(uint8_t)*parser->head] & CHAR_SPACE)) return;
+    parser->head = scan_whitespace(parser->head, parser->end);
+}
+
 static void skip_whitespace(parsec* parser) {
-    while(current(parser) != '\n' && utf8_isWhitespace(current(parser)) && !end(parser)) next_char(parser);
+    STAT_BEGIN(parser, PARSEC_STAT_WHITESPACE);
+    skip_spaces(parser);
+    STAT_END(parser, PARSEC_STAT_WHITESPACE);
 }
 
 static void skip_line(parsec* parser) {
-    while(!end(parser) && current(parser) != '\n') next_char(parser);
+    STAT_BEGIN(parser, PARSEC_STAT_LINE);
+    // '\n' can never be part of a multibyte sequence, so we can look at bytes directly
+    const char* start = parser->head;
+    parser->head = scan_newline(parser->head, parser->end);
+    STAT_NON_ASCII_RANGE(parser, start, parser->head);
+    STAT_END(parser, PARSEC_STAT_LINE);
 }
 
 parsec_kind token_type(codepoint_t c, char comment_char) {
-    if(utf8_isIdentifierHead(c))                                    return PARSEC_TOKEN_KEY;
-    if(c == '-' || c == '+' || c == '.' || (c >= '0' && c <= '9'))  return PARSEC_TOKEN_INT;
+    uint8_t cls = classify(c);
+    if(cls & CHAR_IDENT_HEAD)                                       return PARSEC_TOKEN_KEY;
+    if(cls & CHAR_NUMBER)                                           return PARSEC_TOKEN_INT;
     if(c == comment_char)                                           return PARSEC_TOKEN_COMMENT;
-    if(c == '@')                                                    return PARSEC_TOKEN_MARKER;
-    if(c == '\'')                                                   return PARSEC_TOKEN_STRING;
-    if(c == '\n')                                                   return PARSEC_TOKEN_NEWLINE;
+    if(cls & CHAR_MARKER)                                           return PARSEC_TOKEN_MARKER;
+    if(cls & CHAR_QUOTE)                                            return PARSEC_TOKEN_STRING;
+    if(cls & CHAR_NEWLINE)                                          return PARSEC_TOKEN_NEWLINE;
+    if(c >= 0x80 && utf8_isIdentifierHead(c))                      return PARSEC_TOKEN_KEY;
     return PARSEC_TOKEN_INVALID;
 }
 
+// Lexes the token at the parser's head, which must not be whitespace or the end of the input.
+static bool lex_dispatch(parsec* parser, parsec_token* token, parsec_value* value) {
+    // We save the current head for two reasons:
+    //      - if the token parsing fails for any reason, we can restore (for reentrance)
+    //      - if the token parsing goes well, then we have the start index
+    const char* start = parser->head;
+    token->keyword = PARSEC_KEYWORD_UNKNOWN;
+    
+    codepoint_t c = current(parser);
+    switch (token_type(c, parser->comment_char)) {
+    
+    case PARSEC_TOKEN_COMMENT:
+        token->kind = PARSEC_TOKEN_COMMENT;
+        token->start = start;
+        skip_line(parser);
+        token->length = (parser->head - start);
+        break;
+        
+    case PARSEC_TOKEN_MARKER:
+        token->kind = PARSEC_TOKEN_MARKER;
+        token->start = start;
+        next_char(parser);
+        token->length = (parser->head - start);
+        break;
+        
+    case PARSEC_TOKEN_NEWLINE:
+        token->kind = PARSEC_TOKEN_NEWLINE;
+        token->start = start;
+        next_char(parser);
+        token->length = (parser->head - start);
+        break;
+        
+    case PARSEC_TOKEN_KEY: {
+        STAT_BEGIN(parser, PARSEC_STAT_KEY);
+        bool valid = parse_key(parser, token);
+        STAT_END(parser, PARSEC_STAT_KEY);
+        if(!valid) return false;
+        if(parser->keywords) token->keyword = parsec_keywords_find(parser->keywords, token->start, token->length);
+        break;
+    }
+    
+    case PARSEC_TOKEN_INT:
+    case PARSEC_TOKEN_FLOAT: {
+        STAT_BEGIN(parser, PARSEC_STAT_NUMBER);
+        bool valid = parse_number(parser, token, value);
+        STAT_END(parser, PARSEC_STAT_NUMBER);
+        if(!valid) return false;
+        break;
+    }
+    
+    case PARSEC_TOKEN_STRING: {
+        STAT_BEGIN(parser, PARSEC_STAT_STRING);
+        bool valid = parse_string(parser, token);
+        STAT_END(parser, PARSEC_STAT_STRING);
+        if(!valid) return false;
+        break;
+    }
+    
+    case PARSEC_TOKEN_INVALID:
+        return false;
+        break;
+    }
+    return true;
+}
+
+static inline bool lex_token(parsec* parser, parsec_token* token, parsec_value* value) {
+    bool valid = lex_dispatch(parser, token, value);
+    STAT_TOKEN(parser, valid ? token->kind : PARSEC_TOKEN_INVALID, valid ? token->length : 0);
+    return valid;
+}
+
 // MARK: - Public API implementation
 
 void parsec_init(parsec* parser, const char* source, uint64_t length, char comment_char) {
@@ -163,6 +350,39 @@ void parsec_init(parsec* parser, const char* source, uint64_t length, char comme
     parser->head            = source;
     parser->next_token      = 0;
     parser->comment_char    = comment_char;
+    parser->keywords        = NULL;
+    parser->dialect         = PARSEC_DIALECT_DEFAULT;
+    parser->validated       = parsec_utf8_valid(source, length);
+    parsec_stats_reset(parser);
+}
+
+bool parsec_utf8_valid(const char* data, uint64_t length) {
+    assert((data || !length) && "Invalid data given");
+    return scan_utf8(data, data + length);
+}
+
+int8_t parsec_utf8_size(const char* ptr, uint64_t length) {
+    assert(ptr && length && "Invalid data given");
+    codepoint_t c = utf8_getCodepoint(ptr, length);
+    return c < 0 ? -1 : utf8_codepointSize(c);
+}
+
+bool parsec_utf8_identifier(const char* ptr, uint64_t length, bool head) {
+    assert(ptr && length && "Invalid data given");
+    codepoint_t c = utf8_getCodepoint(ptr, length);
+    if(c < 0x80) return classify(c) & (head ? CHAR_IDENT_HEAD : CHAR_IDENT);
+    return head ? utf8_isIdentifierHead(c) : utf8_isIdentifier(c);
+}
+
+void parsec_set_keywords(parsec* parser, const parsec_keywords* keywords) {
+    assert(parser && "Invalid ParseC status given");
+    parser->keywords = keywords;
+}
+
+void parsec_set_dialect(parsec* parser, parsec_dialect dialect) {
+    assert(parser && "Invalid ParseC status given");
+    assert(dialect < PARSEC_DIALECT_COUNT && "Invalid number dialect given");
+    parser->dialect = dialect;
 }
 
 parsec_result parsec_lex(parsec* parser, parsec_token* tokens, uint64_t token_count) {
@@ -174,130 +394,139 @@ parsec_result parsec_lex(parsec* parser, parsec_token* tokens, uint64_t token_co
         
         // Get the next token to fill up, or fail
         if(parser->next_token >= token_count) return PARSEC_NOMEM;
-        parsec_token* token = &tokens[parser->next_token++];
-        
-        // We save the current head for two reasons:
-        //      - if the token parsing fails for any reason, we can restore (for reentrance)
-        //      - if the token parsing goes well, then we have the start index
-        const char* start = parser->head;
-        
-        codepoint_t c = current(parser);
-        switch (token_type(c, parser->comment_char)) {
-        
-        case PARSEC_TOKEN_COMMENT:
-            token->kind = PARSEC_TOKEN_COMMENT;
-            token->start = start;
-            skip_line(parser);
-            token->length = (parser->head - start);
-            break;
-            
-        case PARSEC_TOKEN_MARKER:
-            token->kind = PARSEC_TOKEN_MARKER;
-            token->start = start;
-            next_char(parser);
-            token->length = (parser->head - start);
-            break;
-            
-        case PARSEC_TOKEN_NEWLINE:
-            token->kind = PARSEC_TOKEN_NEWLINE;
-            token->start = start;
-            next_char(parser);
-            token->length = (parser->head - start);
-            break;
-            
-        case PARSEC_TOKEN_KEY:
-            if(!parse_key(parser, token)) return PARSEC_INVALID;
-            break;
-            
-        case PARSEC_TOKEN_INT:
-        case PARSEC_TOKEN_FLOAT:
-            if(!parse_number(parser, token)) return PARSEC_INVALID;
-            break;
-            
-        case PARSEC_TOKEN_STRING:
-            if(!parse_string(parser, token)) return PARSEC_INVALID;
-            break;
-            
-        case PARSEC_TOKEN_INVALID:
-            return PARSEC_INVALID;
-            break;
-        }
+        if(!lex_token(parser, &tokens[parser->next_token++], NULL)) return PARSEC_INVALID;
     }
     return parser->next_token;
 }
 
-bool parsec_token_cmp(parsec_token token, const char* str) {
-    return memcmp(token.start, str, token.length) == 0;
+parsec_result parsec_lex_values(parsec* parser, parsec_token* tokens, parsec_value* values,
+                                uint64_t token_count) {
+    assert(parser && "Invalid ParseC status given");
+    assert(values && "Invalid value array given");
+    
+    for(;;) {
+        skip_whitespace(parser);
+        if(end(parser)) break;
+        
+        if(parser->next_token >= token_count) return PARSEC_NOMEM;
+        parsec_idx index = parser->next_token++;
+        if(!lex_token(parser, &tokens[index], &values[index])) return PARSEC_INVALID;
+    }
+    return parser->next_token;
 }
 
-static int64_t max_power10(int64_t n) {
-    int64_t p = 1;
-    while(n > p) p *= 10;
-    return p;
+parsec_result parsec_next_value(parsec* parser, parsec_token* token, parsec_value* value) {
+    assert(parser && "Invalid ParseC status given");
+    assert(token && value && "Invalid token given");
+    
+    skip_whitespace(parser);
+    if(end(parser)) return 0;
+    if(!lex_token(parser, token, value)) return PARSEC_INVALID;
+    return 1;
 }
 
-double parsec_str_double(const char* ptr, parsec_idx length) {
-    bool sign = true;
-    bool exp_sign = true;
-    int64_t integral = 0;
-    int64_t decimal = 0;
-    int64_t exponent = 0;
-    double floating = 0.0;
-    const char* end = ptr + length;
-    
-    if(*ptr == '-' || *ptr == '+') {
-        sign = *ptr == '+';
-        ptr++;
-    }
+parsec_result parsec_next(parsec* parser, parsec_token* token) {
+    assert(parser && "Invalid ParseC status given");
+    assert(token && "Invalid token given");
     
-    while(*ptr >= '0' && *ptr <= '9') {
-        integral = integral * 10 + (*ptr - '0');
-        if(++ptr == end) { return sign ? integral : -integral; }
-    }
+    skip_whitespace(parser);
+    if(end(parser)) return 0;
+    if(!lex_token(parser, token, NULL)) return PARSEC_INVALID;
+    return 1;
+}
+
+// Packs [token] into an offset from the start of the input, and its length and kind in 32 bits.
+static bool pack_token(const parsec* parser, const parsec_token* token, parsec_packed_token* packed) {
+    uint64_t offset = token->start - parser->data;
+    if(offset > UINT32_MAX || token->length > PARSEC_PACKED_MAX_LENGTH) return false;
+    packed->offset = (uint32_t)offset;
+    packed->info = token->length | ((uint32_t)(uint8_t)token->kind << 24);
+    return true;
+}
+
+parsec_result parsec_lex_packed(parsec* parser, parsec_packed_token* tokens, uint64_t token_count) {
+    assert(parser && "Invalid ParseC status given");
     
-    if(*ptr == '.') {
-        ptr++;
-        while(*ptr >= '0' && *ptr <= '9') {
-            decimal = decimal * 10 + (*ptr - '0');
-            if(++ptr != end) continue;
-            int64_t d = max_power10(decimal);
-            double val = ((double)integral + (double)decimal/(double)d);
-            return sign ? val : - val;
+    for(;;) {
+        skip_whitespace(parser);
+        if(end(parser)) break;
+        
+        if(parser->next_token >= token_count) return PARSEC_NOMEM;
+        parsec_token token;
+        if(!lex_token(parser, &token, NULL)) {
+            parser->next_token += 1;
+            return PARSEC_INVALID;
         }
+        if(!pack_token(parser, &token, &tokens[parser->next_token])) {
+            parser->head = token.start;
+            return PARSEC_OVERFLOW;
+        }
+        parser->next_token += 1;
     }
+    return parser->next_token;
+}
+
+parsec_result parsec_lex_soa(parsec* parser, parsec_token_soa* tokens, uint64_t token_count) {
+    assert(parser && "Invalid ParseC status given");
+    assert(tokens && "Invalid token arrays given");
     
-    int64_t d = max_power10(decimal);
-    floating = ((double)integral + (double)decimal/(double)d);
-    
-    if(*ptr == 'e' || *ptr == 'E' || *ptr == 'd' || *ptr == 'D') {
-        ptr++;
-        if(*ptr == '-' || *ptr == '+') {
-            sign = *ptr == '+';
-            ptr++;
+    for(;;) {
+        skip_whitespace(parser);
+        if(end(parser)) break;
+        
+        if(parser->next_token >= token_count) return PARSEC_NOMEM;
+        parsec_token token;
+        if(!lex_token(parser, &token, NULL)) {
+            parser->next_token += 1;
+            return PARSEC_INVALID;
         }
-        while(*ptr >= '0' && *ptr <= '9') {
-            exponent = exponent * 10 + (*ptr - '0');
-            if(++ptr != end) continue;
-            floating = floating * (exp_sign ? pow(10, exponent) : -pow(10, exponent));
+        uint64_t offset = token.start - parser->data;
+        if(offset > UINT32_MAX) {
+            parser->head = token.start;
+            return PARSEC_OVERFLOW;
         }
+        tokens->kinds[parser->next_token] = (int8_t)token.kind;
+        tokens->offsets[parser->next_token] = (uint32_t)offset;
+        tokens->lengths[parser->next_token] = token.length;
+        parser->next_token += 1;
     }
-    return sign ? floating : -floating;
+    return parser->next_token;
 }
 
-int32_t parsec_str_int(const char* ptr, parsec_idx length) {
-    bool sign = true;
-    int32_t intval = 0;
-    const char* end = ptr + length;
-    
-    if(*ptr == '-' || *ptr == '+') {
-        sign = *ptr == '+';
-        ptr++;
+bool parsec_token_cmp(parsec_token token, const char* str) {
+    return memcmp(token.start, str, token.length) == 0;
+}
+
+const char* parsec_kind_name(parsec_kind kind) {
+    static const char* names[PARSEC_KIND_COUNT] = {
+        "invalid", "string", "key", "int", "float", "comment", "newline", "marker"
+    };
+    if(kind < PARSEC_TOKEN_INVALID || kind > PARSEC_TOKEN_MARKER) return "unknown";
+    return names[kind + 1];
+}
+
+const char* parsec_stat_section_name(parsec_stat_section section) {
+    static const char* names[PARSEC_STAT_SECTION_COUNT] = {
+        "parse_number", "parse_key", "parse_string", "skip_whitespace", "skip_line"
+    };
+    if(section < 0 || section >= PARSEC_STAT_SECTION_COUNT) return "unknown";
+    return names[section];
+}
+
+void parsec_stats_reset(parsec* parser) {
+    assert(parser && "Invalid ParseC status given");
+    memset(&parser->stats, 0, sizeof(parsec_stats));
+}
+
+void parsec_stats_merge(parsec_stats* into, const parsec_stats* from) {
+    for(int i = 0; i < PARSEC_KIND_COUNT; ++i) {
+        into->tokens[i] += from->tokens[i];
+        into->bytes[i] += from->bytes[i];
     }
-    
-    while(ptr != end) {
-        intval = intval * 10 + (*ptr - '0');
-        ptr++;
+    into->non_ascii += from->non_ascii;
+    for(int i = 0; i < PARSEC_STAT_SECTION_COUNT; ++i) {
+        into->calls[i] += from->calls[i];
+        into->cycles[i] += from->cycles[i];
+        into->samples[i] += from->samples[i];
     }
-    return sign ? intval : -intval;
 }
-
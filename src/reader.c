@@ -0,0 +1,395 @@
+//===--------------------------------------------------------------------------------------------===
+// reader.c - Lexing files that are read and decoded on a background thread
+// This source is part of ParseC
+//
+// Copyright (c) 2018 Amy Parent <amy@amyparent.com>
+// Licensed under the MIT License
+// =^•.•^=
+//===--------------------------------------------------------------------------------------------===
+#include <assert.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <parsec/parsec.h>
+#ifdef PARSEC_WITH_ZLIB
+#include <zlib.h>
+#endif
+#ifdef PARSEC_WITH_ZSTD
+#include <zstd.h>
+#endif
+
+// The decoder thread can run at most READER_BLOCKS - 1 blocks ahead of the lexer.
+#define READER_BLOCK_SIZE   (256 * 1024)
+#define READER_BLOCKS       3
+
+// Where the bytes come from. [read] returns the number of bytes written to [buffer], 0 once the
+// input is exhausted, or -1 if it can't be read or decoded.
+typedef struct {
+    int64_t     (*read)(void* state, char* buffer, uint64_t size);
+    void        (*close)(void* state);
+    void*       state;
+} reader_source;
+
+typedef struct {
+    char*       data;
+    int64_t     length;
+} reader_block;
+
+struct parsec_reader_s {
+    parsec_stream   stream;
+    reader_source   source;
+    
+    pthread_t       thread;
+    pthread_mutex_t lock;
+    pthread_cond_t  filled;
+    pthread_cond_t  drained;
+    reader_block    blocks[READER_BLOCKS];
+    unsigned        read_index;
+    unsigned        write_index;
+    unsigned        ready;
+    bool            stop;
+    
+    bool            resume;
+    bool            eof;
+    bool            failed;
+};
+
+// MARK: - Decoder thread
+
+// Only the decoder thread touches blocks that aren't ready, so decoding runs without the lock.
+static void* reader_fill(void* data) {
+    parsec_reader* reader = data;
+    
+    for(;;) {
+        pthread_mutex_lock(&reader->lock);
+        while(reader->ready == READER_BLOCKS && !reader->stop)
+            pthread_cond_wait(&reader->drained, &reader->lock);
+        if(reader->stop) {
+            pthread_mutex_unlock(&reader->lock);
+            return NULL;
+        }
+        reader_block* block = &reader->blocks[reader->write_index];
+        pthread_mutex_unlock(&reader->lock);
+        
+        int64_t length = reader->source.read(reader->source.state, block->data, READER_BLOCK_SIZE);
+        
+        pthread_mutex_lock(&reader->lock);
+        block->length = length;
+        reader->write_index = (reader->write_index + 1) % READER_BLOCKS;
+        reader->ready += 1;
+        pthread_cond_signal(&reader->filled);
+        pthread_mutex_unlock(&reader->lock);
+        
+        // An empty or failed block is the last one.
+        if(length <= 0) return NULL;
+    }
+}
+
+static reader_block* reader_wait(parsec_reader* reader) {
+    pthread_mutex_lock(&reader->lock);
+    while(!reader->ready) pthread_cond_wait(&reader->filled, &reader->lock);
+    reader_block* block = &reader->blocks[reader->read_index];
+    pthread_mutex_unlock(&reader->lock);
+    return block;
+}
+
+static void reader_release(parsec_reader* reader) {
+    pthread_mutex_lock(&reader->lock);
+    reader->read_index = (reader->read_index + 1) % READER_BLOCKS;
+    reader->ready -= 1;
+    pthread_cond_signal(&reader->drained);
+    pthread_mutex_unlock(&reader->lock);
+}
+
+// Takes ownership of [source]: it's closed if the reader can't be created.
+static parsec_result reader_start(parsec_reader** out, reader_source source, char comment_char) {
+    parsec_reader* reader = calloc(1, sizeof(parsec_reader));
+    char* data = malloc(READER_BLOCKS * READER_BLOCK_SIZE);
+    if(!reader || !data) {
+        free(reader);
+        free(data);
+        source.close(source.state);
+        return PARSEC_NOALLOC;
+    }
+    
+    parsec_stream_init(&reader->stream, comment_char);
+    reader->source = source;
+    for(unsigned i = 0; i < READER_BLOCKS; ++i)
+        reader->blocks[i].data = data + i * READER_BLOCK_SIZE;
+    
+    pthread_mutex_init(&reader->lock, NULL);
+    pthread_cond_init(&reader->filled, NULL);
+    pthread_cond_init(&reader->drained, NULL);
+    if(pthread_create(&reader->thread, NULL, reader_fill, reader) != 0) {
+        pthread_cond_destroy(&reader->drained);
+        pthread_cond_destroy(&reader->filled);
+        pthread_mutex_destroy(&reader->lock);
+        source.close(source.state);
+        free(data);
+        free(reader);
+        return PARSEC_NOALLOC;
+    }
+    *out = reader;
+    return PARSEC_SUCCESS;
+}
+
+// MARK: - Sources
+
+typedef struct {
+    int             fd;
+    uint64_t        offset;
+} plain_source;
+
+// Blocks are read at explicit offsets, and the kernel is asked to start fetching the next one
+// before this one is read: the disk stays busy while the block is copied out and lexed.
+static int64_t plain_read(void* state, char* buffer, uint64_t size) {
+    plain_source* source = state;
+    posix_fadvise(source->fd, source->offset + size, READER_BLOCK_SIZE, POSIX_FADV_WILLNEED);
+    
+    uint64_t length = 0;
+    while(length < size) {
+        ssize_t read = pread(source->fd, buffer + length, size - length, source->offset + length);
+        if(read < 0 && errno == EINTR) continue;
+        if(read < 0) return -1;
+        if(read == 0) break;
+        length += read;
+    }
+    source->offset += length;
+    return length;
+}
+
+static void plain_close(void* state) {
+    plain_source* source = state;
+    close(source->fd);
+    free(source);
+}
+
+static parsec_result plain_open(reader_source* source, FILE* file) {
+    plain_source* plain = malloc(sizeof(plain_source));
+    int fd = dup(fileno(file));
+    fclose(file);
+    if(!plain || fd < 0) {
+        if(fd >= 0) close(fd);
+        free(plain);
+        return plain ? PARSEC_NOFILE : PARSEC_NOALLOC;
+    }
+    
+    // Only a hint, like the madvise calls in parsec_open_file.
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    plain->fd = fd;
+    plain->offset = 0;
+    *source = (reader_source){plain_read, plain_close, plain};
+    return PARSEC_SUCCESS;
+}
+
+#ifdef PARSEC_WITH_ZLIB
+static int64_t gzip_read(void* state, char* buffer, uint64_t size) {
+    int length = gzread(state, buffer, (unsigned)size);
+    if(length != 0) return length;
+    
+    // A truncated archive reads as a short file, with the error only reported through gzerror.
+    int error = Z_OK;
+    gzerror(state, &error);
+    return error == Z_OK || error == Z_STREAM_END ? 0 : -1;
+}
+
+static void gzip_close(void* state) {
+    gzclose(state);
+}
+
+static parsec_result gzip_open(reader_source* source, FILE* file) {
+    int fd = dup(fileno(file));
+    fclose(file);
+    if(fd < 0) return PARSEC_NOFILE;
+    // gzdopen only takes ownership of the descriptor when it succeeds.
+    gzFile archive = gzdopen(fd, "rb");
+    if(!archive) {
+        close(fd);
+        return PARSEC_NOFILE;
+    }
+    gzbuffer(archive, READER_BLOCK_SIZE);
+    *source = (reader_source){gzip_read, gzip_close, archive};
+    return PARSEC_SUCCESS;
+}
+#endif
+
+#ifdef PARSEC_WITH_ZSTD
+typedef struct {
+    FILE*           file;
+    ZSTD_DCtx*      context;
+    ZSTD_inBuffer   input;
+    char*           buffer;
+    size_t          capacity;
+    size_t          status;
+    bool            eof;
+} zstd_source;
+
+static int64_t zstd_read(void* state, char* buffer, uint64_t size) {
+    zstd_source* source = state;
+    ZSTD_outBuffer output = {buffer, size, 0};
+    
+    while(output.pos < output.size) {
+        if(source->input.pos == source->input.size && !source->eof) {
+            size_t read = fread(source->buffer, 1, source->capacity, source->file);
+            if(ferror(source->file)) return -1;
+            source->eof = read == 0;
+            source->input = (ZSTD_inBuffer){source->buffer, read, 0};
+        }
+        
+        // Once the file is exhausted, the decoder may still be holding on to output.
+        size_t before = output.pos;
+        size_t consumed = source->input.pos;
+        size_t status = ZSTD_decompressStream(source->context, &output, &source->input);
+        if(ZSTD_isError(status)) return -1;
+        bool progress = output.pos != before || source->input.pos != consumed;
+        // A call that did nothing only hints at the size of the next frame's header, so it says
+        // nothing about the last one: [status] is only kept from calls that did some work.
+        if(progress) source->status = status;
+        if(source->eof && !progress) {
+            // Unless the last frame was flushed completely, the file was cut short.
+            if(source->status != 0) return -1;
+            break;
+        }
+    }
+    return output.pos;
+}
+
+static void zstd_close(void* state) {
+    zstd_source* source = state;
+    ZSTD_freeDCtx(source->context);
+    fclose(source->file);
+    free(source->buffer);
+    free(source);
+}
+
+static parsec_result zstd_open(reader_source* source, FILE* file) {
+    zstd_source* zstd = calloc(1, sizeof(zstd_source));
+    if(zstd) {
+        zstd->capacity = ZSTD_DStreamInSize();
+        zstd->buffer = malloc(zstd->capacity);
+        zstd->context = ZSTD_createDCtx();
+    }
+    if(!zstd || !zstd->buffer || !zstd->context) {
+        if(zstd) {
+            ZSTD_freeDCtx(zstd->context);
+            free(zstd->buffer);
+        }
+        free(zstd);
+        fclose(file);
+        return PARSEC_NOALLOC;
+    }
+    zstd->file = file;
+    zstd->status = 1;   // no frame has been completed yet
+    *source = (reader_source){zstd_read, zstd_close, zstd};
+    return PARSEC_SUCCESS;
+}
+#endif
+
+// Picks a decoder from the first bytes of [file]. Archives in a format that wasn't compiled in
+// are rejected rather than lexed as garbage.
+static parsec_result reader_source_open(reader_source* source, FILE* file) {
+    static const uint8_t gzip_magic[] = {0x1f, 0x8b};
+    static const uint8_t zstd_magic[] = {0x28, 0xb5, 0x2f, 0xfd};
+    
+    uint8_t magic[4] = {0};
+    size_t length = fread(magic, 1, sizeof(magic), file);
+    if(ferror(file) || fseek(file, 0, SEEK_SET) != 0) {
+        fclose(file);
+        return PARSEC_NOFILE;
+    }
+    
+    if(length >= sizeof(gzip_magic) && !memcmp(magic, gzip_magic, sizeof(gzip_magic))) {
+#ifdef PARSEC_WITH_ZLIB
+        return gzip_open(source, file);
+#else
+        fclose(file);
+        return PARSEC_NOFILE;
+#endif
+    }
+    if(length >= sizeof(zstd_magic) && !memcmp(magic, zstd_magic, sizeof(zstd_magic))) {
+#ifdef PARSEC_WITH_ZSTD
+        return zstd_open(source, file);
+#else
+        fclose(file);
+        return PARSEC_NOFILE;
+#endif
+    }
+    return plain_open(source, file);
+}
+
+// MARK: - Public API implementation
+
+parsec_result parsec_reader_open(parsec_reader** reader, const char* path, char comment_char) {
+    assert(reader && "Invalid ParseC reader given");
+    assert(path && "Invalid file path given");
+    
+    FILE* file = fopen(path, "rb");
+    if(!file) return PARSEC_NOFILE;
+    
+    reader_source source;
+    parsec_result result = reader_source_open(&source, file);
+    if(result != PARSEC_SUCCESS) return result;
+    return reader_start(reader, source, comment_char);
+}
+
+void parsec_reader_close(parsec_reader* reader) {
+    if(!reader) return;
+    
+    pthread_mutex_lock(&reader->lock);
+    reader->stop = true;
+    pthread_cond_signal(&reader->drained);
+    pthread_mutex_unlock(&reader->lock);
+    pthread_join(reader->thread, NULL);
+    
+    reader->source.close(reader->source.state);
+    pthread_cond_destroy(&reader->drained);
+    pthread_cond_destroy(&reader->filled);
+    pthread_mutex_destroy(&reader->lock);
+    parsec_stream_deinit(&reader->stream);
+    free(reader->blocks[0].data);
+    free(reader);
+}
+
+// parsec_feed and parsec_finish report a full token array as PARSEC_NOMEM; here that only means
+// the next call has to pick up where this one stopped.
+static parsec_result reader_result(parsec_reader* reader, parsec_result result) {
+    if(result != PARSEC_NOMEM) return result;
+    reader->resume = true;
+    return (parsec_result)reader->stream.parser.next_token;
+}
+
+parsec_result parsec_reader_lex(parsec_reader* reader, parsec_token* tokens, uint64_t token_count) {
+    assert(reader && "Invalid ParseC reader given");
+    assert(tokens && token_count && "Invalid token array given");
+    if(reader->failed) return PARSEC_NOFILE;
+    
+    if(reader->resume) {
+        reader->resume = false;
+        parsec_result result = reader->eof
+            ? parsec_finish(&reader->stream, tokens, token_count)
+            : parsec_feed(&reader->stream, NULL, 0, tokens, token_count);
+        if(result != PARSEC_SUCCESS) return reader_result(reader, result);
+    }
+    
+    // The stream copies each block, so it goes back to the decoder as soon as it's been fed.
+    while(!reader->eof) {
+        reader_block* block = reader_wait(reader);
+        int64_t length = block->length;
+        parsec_result result = PARSEC_SUCCESS;
+        if(length > 0) result = parsec_feed(&reader->stream, block->data, length, tokens, token_count);
+        reader_release(reader);
+        
+        if(length < 0) {
+            reader->failed = true;
+            return PARSEC_NOFILE;
+        }
+        if(length == 0) reader->eof = true;
+        else if(result != PARSEC_SUCCESS) return reader_result(reader, result);
+    }
+    return reader_result(reader, parsec_finish(&reader->stream, tokens, token_count));
+}
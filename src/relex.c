@@ -0,0 +1,106 @@
+//===--------------------------------------------------------------------------------------------===
+// relex.c - Incremental re-lexing after edits
+// This source is part of ParseC
+//
+// Copyright (c) 2018 Amy Parent <amy@amyparent.com>
+// Licensed under the MIT License
+// =^•.•^=
+//===--------------------------------------------------------------------------------------------===
+#include "scan.h"
+#include <assert.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <parsec/parsec.h>
+
+// Returns the index of the first token that starts at or after [offset] in the old source.
+static uint64_t find_token(const parsec_token* tokens, uint64_t count, const char* old_data, uint64_t offset) {
+    uint64_t low = 0;
+    uint64_t high = count;
+    while(low < high) {
+        uint64_t mid = low + (high - low) / 2;
+        if((uint64_t)(tokens[mid].start - old_data) < offset) low = mid + 1;
+        else high = mid;
+    }
+    return low;
+}
+
+// Lexes [parser]'s remaining input into a fresh array, grown as needed.
+static parsec_result lex_region(parsec* parser, parsec_token** tokens) {
+    uint64_t capacity = 64;
+    *tokens = NULL;
+    for(;;) {
+        parsec_token* grown = realloc(*tokens, capacity * sizeof(parsec_token));
+        if(!grown) return PARSEC_NOALLOC;
+        *tokens = grown;
+        parsec_result result = parsec_lex(parser, *tokens, capacity);
+        if(result != PARSEC_NOMEM) return result;
+        capacity *= 2;
+    }
+}
+
+parsec_result parsec_relex(parsec* parser, const char* data, parsec_edit edit,
+                           parsec_token* tokens, uint64_t token_count, uint64_t capacity) {
+    assert(parser && "Invalid ParseC status given");
+    assert(data && "Invalid source given");
+    assert((tokens || !token_count) && "Invalid tokens given");
+    
+    const char* old_data = parser->data;
+    uint64_t old_length = parser->end - old_data;
+    if(edit.offset + edit.removed > old_length) return PARSEC_INVALID;
+    int64_t delta = (int64_t)edit.inserted - (int64_t)edit.removed;
+    uint64_t length = old_length + delta;
+    
+    // The parser moves to the new source without going through parsec_init, which would validate
+    // all of it again: the rest of the input was checked already.
+    parser->data = data;
+    parser->end = data + length;
+    parser->head = data;
+    
+    // Tokens never span lines, so only the lines touched by the edit need to be lexed again: from
+    // the start of the line the edit begins on, to the end of the line it ends on.
+    const char* start = data + edit.offset;
+    while(start > data && start[-1] != '\n') start -= 1;
+    const char* end = scan_newline(data + edit.offset + edit.inserted, parser->end);
+    if(end < parser->end) end += 1;
+    
+    uint64_t first = find_token(tokens, token_count, old_data, start - data);
+    uint64_t last = find_token(tokens, token_count, old_data, (end - data) - delta);
+    if(end == parser->end) last = token_count;
+    
+    parsec region = *parser;
+    region.head = start;
+    region.end = end;
+    region.next_token = 0;
+    region.validated = parsec_utf8_valid(start, end - start);
+    parser->validated = parser->validated && region.validated;
+    parsec_token* lexed;
+    parsec_result result = lex_region(&region, &lexed);
+    if(result < 0) {
+        if(result == PARSEC_INVALID) parser->head = region.head;
+        free(lexed);
+        return result;
+    }
+    
+    uint64_t count = (uint64_t)result;
+    uint64_t total = token_count - (last - first) + count;
+    if(total > capacity) {
+        free(lexed);
+        return PARSEC_NOMEM;
+    }
+    
+    // Tokens after the edited lines keep their text, but it moved by [delta] bytes.
+    memmove(tokens + first + count, tokens + last, (token_count - last) * sizeof(parsec_token));
+    for(uint64_t i = first + count; i < total; ++i) {
+        tokens[i].start = data + (tokens[i].start - old_data) + delta;
+    }
+    if(data != old_data) {
+        for(uint64_t i = 0; i < first; ++i) tokens[i].start = data + (tokens[i].start - old_data);
+    }
+    memcpy(tokens + first, lexed, count * sizeof(parsec_token));
+    free(lexed);
+    
+    parser->head = parser->end;
+    parser->next_token = total;
+    return (parsec_result)total;
+}
@@ -0,0 +1,352 @@
+//===--------------------------------------------------------------------------------------------===
+// scan.c - Vectorised scanning kernels used by the lexer's inner loops
+// This source is part of ParseC
+//
+// Copyright (c) 2018 Amy Parent <amy@amyparent.com>
+// Licensed under the MIT License
+// =^•.•^=
+//===--------------------------------------------------------------------------------------------===
+#include "scan.h"
+#include "utf8.h"
+#include <stdbool.h>
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__)))
+#define SCAN_X86 1
+#include <immintrin.h>
+#endif
+
+// MARK: - Scalar fallbacks
+
+static inline bool is_space(uint8_t c) {
+    return c == ' ' || c == '\0' || (c >= '\t' && c <= '\r' && c != '\n');
+}
+
+static inline bool is_string_stop(uint8_t c) {
+    return c == '\'' || c == '\n' || c >= 0x80;
+}
+
+static const char* scalar_whitespace(const char* ptr, const char* end) {
+    while(ptr < end && is_space((uint8_t)*ptr)) ptr += 1;
+    return ptr;
+}
+
+static const char* scalar_newline(const char* ptr, const char* end) {
+    while(ptr < end && *ptr != '\n') ptr += 1;
+    return ptr;
+}
+
+static const char* scalar_string(const char* ptr, const char* end) {
+    while(ptr < end && !is_string_stop((uint8_t)*ptr)) ptr += 1;
+    return ptr;
+}
+
+static const char* scalar_ascii(const char* ptr, const char* end) {
+    while(ptr < end && (uint8_t)*ptr < 0x80) ptr += 1;
+    return ptr;
+}
+
+// ASCII is skipped with the best scan_ascii available, and only the multibyte sequences in between
+// are checked byte by byte.
+static bool scalar_utf8(const char* ptr, const char* end) {
+    while((ptr = scan_ascii(ptr, end)) < end) {
+        do {
+            int8_t size = utf8_checkSequence(ptr, end - ptr);
+            if(size < 0) return false;
+            ptr += size;
+        } while(ptr < end && (uint8_t)*ptr >= 0x80);
+    }
+    return true;
+}
+
+#ifdef SCAN_X86
+
+// MARK: - SSE2 kernels (16 bytes at a time)
+
+// Each of these returns a mask with a bit set for every byte that should stop the scan.
+
+static inline uint32_t sse2_whitespace_mask(__m128i v) {
+    // '\t' to '\r' is a contiguous range: (v - '\t') <= 4 in unsigned arithmetic
+    __m128i shifted = _mm_sub_epi8(v, _mm_set1_epi8('\t'));
+    __m128i ranged = _mm_cmpeq_epi8(_mm_min_epu8(shifted, _mm_set1_epi8(4)), shifted);
+    __m128i space = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')),
+                                 _mm_cmpeq_epi8(v, _mm_setzero_si128()));
+    space = _mm_or_si128(space, _mm_andnot_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')), ranged));
+    return ~(uint32_t)_mm_movemask_epi8(space) & 0xffff;
+}
+
+static inline uint32_t sse2_newline_mask(__m128i v) {
+    return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')));
+}
+
+static inline uint32_t sse2_string_mask(__m128i v) {
+    __m128i stop = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\'')),
+                                _mm_cmpeq_epi8(v, _mm_set1_epi8('\n')));
+    // movemask picks the high bit, which is already set for non-ASCII bytes
+    return (uint32_t)_mm_movemask_epi8(_mm_or_si128(stop, v));
+}
+
+static inline uint32_t sse2_ascii_mask(__m128i v) {
+    return (uint32_t)_mm_movemask_epi8(v);
+}
+
+#define SSE2_KERNEL(name, scalar)                                                                   \
+    static const char* sse2_##name(const char* ptr, const char* end) {                              \
+        while(end - ptr >= 16) {                                                                    \
+            uint32_t mask = sse2_##name##_mask(_mm_loadu_si128((const __m128i*)ptr));               \
+            if(mask) return ptr + __builtin_ctz(mask);                                              \
+            ptr += 16;                                                                              \
+        }                                                                                           \
+        return scalar(ptr, end);                                                                    \
+    }
+
+SSE2_KERNEL(whitespace, scalar_whitespace)
+SSE2_KERNEL(newline, scalar_newline)
+SSE2_KERNEL(string, scalar_string)
+SSE2_KERNEL(ascii, scalar_ascii)
+
+// MARK: - AVX2 kernels (32 bytes at a time)
+
+#define AVX2 __attribute__((target("avx2")))
+
+AVX2 static inline uint32_t avx2_whitespace_mask(__m256i v) {
+    __m256i shifted = _mm256_sub_epi8(v, _mm256_set1_epi8('\t'));
+    __m256i ranged = _mm256_cmpeq_epi8(_mm256_min_epu8(shifted, _mm256_set1_epi8(4)), shifted);
+    __m256i space = _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')),
+                                    _mm256_cmpeq_epi8(v, _mm256_setzero_si256()));
+    space = _mm256_or_si256(space, _mm256_andnot_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')), ranged));
+    return ~(uint32_t)_mm256_movemask_epi8(space);
+}
+
+AVX2 static inline uint32_t avx2_newline_mask(__m256i v) {
+    return (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')));
+}
+
+AVX2 static inline uint32_t avx2_string_mask(__m256i v) {
+    __m256i stop = _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\'')),
+                                   _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')));
+    return (uint32_t)_mm256_movemask_epi8(_mm256_or_si256(stop, v));
+}
+
+#define AVX2_KERNEL(name)                                                                           \
+    AVX2 static const char* avx2_##name(const char* ptr, const char* end) {                         \
+        while(end - ptr >= 32) {                                                                    \
+            uint32_t mask = avx2_##name##_mask(_mm256_loadu_si256((const __m256i*)ptr));            \
+            if(mask) return ptr + __builtin_ctz(mask);                                              \
+            ptr += 32;                                                                              \
+        }                                                                                           \
+        return sse2_##name(ptr, end);                                                               \
+    }
+
+AVX2_KERNEL(whitespace)
+AVX2_KERNEL(newline)
+AVX2_KERNEL(string)
+
+// Mostly-ASCII input is the common case, and one branch per 128 bytes keeps this memory-bound.
+AVX2 static const char* avx2_ascii(const char* ptr, const char* end) {
+    while(end - ptr >= 128) {
+        __m256i a = _mm256_loadu_si256((const __m256i*)ptr);
+        __m256i b = _mm256_loadu_si256((const __m256i*)(ptr + 32));
+        __m256i c = _mm256_loadu_si256((const __m256i*)(ptr + 64));
+        __m256i d = _mm256_loadu_si256((const __m256i*)(ptr + 96));
+        __m256i any = _mm256_or_si256(_mm256_or_si256(a, b), _mm256_or_si256(c, d));
+        if(_mm256_movemask_epi8(any)) break;
+        ptr += 128;
+    }
+    while(end - ptr >= 32) {
+        uint32_t mask = (uint32_t)_mm256_movemask_epi8(_mm256_loadu_si256((const __m256i*)ptr));
+        if(mask) return ptr + __builtin_ctz(mask);
+        ptr += 32;
+    }
+    return sse2_ascii(ptr, end);
+}
+
+// UTF-8 validation with lookup tables, after Keiser & Lemire ("Validating UTF-8 In Less Than One
+// Instruction Per Byte"). Each byte is checked together with the three before it: three nibble
+// lookups flag every bad two-byte combination, and the bytes that must be the second or third
+// continuation of a sequence are worked out from the leads two and three bytes back.
+
+enum {
+    UTF8_TOO_SHORT      = 1 << 0,   // a lead not followed by enough continuations
+    UTF8_TOO_LONG       = 1 << 1,   // a continuation after ASCII
+    UTF8_OVERLONG_3     = 1 << 2,
+    UTF8_TOO_LARGE      = 1 << 3,
+    UTF8_SURROGATE      = 1 << 4,
+    UTF8_OVERLONG_2     = 1 << 5,
+    UTF8_TOO_LARGE_1000 = 1 << 6,
+    UTF8_OVERLONG_4     = 1 << 6,
+    UTF8_TWO_CONTS      = 1 << 7,   // two continuations in a row (only fine in longer sequences)
+};
+
+#define UTF8_CARRY (UTF8_TOO_SHORT | UTF8_TOO_LONG | UTF8_TWO_CONTS)
+
+#define AVX2_TABLE(...) _mm256_setr_epi8(__VA_ARGS__, __VA_ARGS__)
+
+// The last 32 bytes before [input], shifted in from [previous].
+#define AVX2_PREV(input, previous, n) \
+    _mm256_alignr_epi8(input, _mm256_permute2x128_si256(previous, input, 0x21), 16 - (n))
+
+AVX2 static inline __m256i avx2_utf8_special(__m256i input, __m256i prev1) {
+    const __m256i nibble = _mm256_set1_epi8(0x0f);
+    const __m256i byte_1_high = AVX2_TABLE(
+        UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG,
+        UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG,
+        UTF8_TWO_CONTS, UTF8_TWO_CONTS, UTF8_TWO_CONTS, UTF8_TWO_CONTS,
+        UTF8_TOO_SHORT | UTF8_OVERLONG_2,
+        UTF8_TOO_SHORT,
+        UTF8_TOO_SHORT | UTF8_OVERLONG_3 | UTF8_SURROGATE,
+        UTF8_TOO_SHORT | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000 | UTF8_OVERLONG_4);
+    const __m256i byte_1_low = AVX2_TABLE(
+        UTF8_CARRY | UTF8_OVERLONG_3 | UTF8_OVERLONG_2 | UTF8_OVERLONG_4,
+        UTF8_CARRY | UTF8_OVERLONG_2,
+        UTF8_CARRY,
+        UTF8_CARRY,
+        UTF8_CARRY | UTF8_TOO_LARGE,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000 | UTF8_SURROGATE,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000);
+    const __m256i byte_2_high = AVX2_TABLE(
+        UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT,
+        UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT,
+        UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_OVERLONG_3 | UTF8_TOO_LARGE_1000
+            | UTF8_OVERLONG_4,
+        UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_OVERLONG_3 | UTF8_TOO_LARGE,
+        UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_SURROGATE | UTF8_TOO_LARGE,
+        UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_SURROGATE | UTF8_TOO_LARGE,
+        UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT);
+    
+    // There's no 8-bit shift, so shift 16-bit lanes and mask off what came from the other byte
+    __m256i high_1 = _mm256_and_si256(_mm256_srli_epi16(prev1, 4), nibble);
+    __m256i low_1 = _mm256_and_si256(prev1, nibble);
+    __m256i high_2 = _mm256_and_si256(_mm256_srli_epi16(input, 4), nibble);
+    return _mm256_and_si256(_mm256_and_si256(_mm256_shuffle_epi8(byte_1_high, high_1),
+                                             _mm256_shuffle_epi8(byte_1_low, low_1)),
+                            _mm256_shuffle_epi8(byte_2_high, high_2));
+}
+
+AVX2 static inline __m256i avx2_utf8_check(__m256i input, __m256i previous) {
+    __m256i special = avx2_utf8_special(input, AVX2_PREV(input, previous, 1));
+    // Leads of three- and four-byte sequences two and three bytes back, which are the only cases
+    // where two continuations in a row are expected.
+    __m256i third = _mm256_subs_epu8(AVX2_PREV(input, previous, 2), _mm256_set1_epi8(0xe0 - 0x80));
+    __m256i fourth = _mm256_subs_epu8(AVX2_PREV(input, previous, 3), _mm256_set1_epi8(0xf0 - 0x80));
+    __m256i expected = _mm256_and_si256(_mm256_or_si256(third, fourth), _mm256_set1_epi8(0x80));
+    return _mm256_xor_si256(expected, special);
+}
+
+// Flags a block that ends in the middle of a sequence, which has to continue into the next one.
+AVX2 static inline __m256i avx2_utf8_incomplete(__m256i input) {
+    const __m256i limits = _mm256_setr_epi8(
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 0xf0 - 1, 0xe0 - 1, 0xc0 - 1);
+    return _mm256_subs_epu8(input, limits);
+}
+
+// Works on 64 bytes at a time, like simdjson: long enough that a run of ASCII (the common case)
+// costs a single branch, short enough that mixed input consistently takes the full check.
+AVX2 static bool avx2_utf8(const char* ptr, const char* end) {
+    __m256i error = _mm256_setzero_si256();
+    __m256i previous = _mm256_setzero_si256();
+    __m256i incomplete = _mm256_setzero_si256();
+    
+    // The tail is checked from a zero-padded copy. Padding is ASCII, so a sequence cut short by
+    // the end of the input shows up as an error in the last block.
+    char tail[64] = {0};
+    bool last = false;
+    while(!last) {
+        const char* block = ptr;
+        if(end - ptr >= 64) {
+            ptr += 64;
+        } else {
+            memcpy(tail, ptr, end - ptr);
+            block = tail;
+            last = true;
+        }
+        __m256i low = _mm256_loadu_si256((const __m256i*)block);
+        __m256i high = _mm256_loadu_si256((const __m256i*)(block + 32));
+        
+        if(!_mm256_movemask_epi8(_mm256_or_si256(low, high))) {
+            error = _mm256_or_si256(error, incomplete);
+        } else {
+            error = _mm256_or_si256(error, avx2_utf8_check(low, previous));
+            error = _mm256_or_si256(error, avx2_utf8_check(high, low));
+            incomplete = avx2_utf8_incomplete(high);
+        }
+        previous = high;
+        
+        // Errors are sticky, so checking them once in a while is enough to stop early
+        if(((uintptr_t)ptr & 0xfff) < 64 && !_mm256_testz_si256(error, error)) return false;
+    }
+    return _mm256_testz_si256(error, error);
+}
+
+#endif /* SCAN_X86 */
+
+// MARK: - Runtime dispatch
+
+// Every kernel pointer starts on a resolver, which picks the implementation on the first call and
+// replaces itself. Concurrent first calls all store the same value, so relaxed atomic stores (and
+// loads, in scan.h) are all the synchronisation needed: there's no data published along with them.
+
+static void resolve(void);
+
+static const char* resolve_whitespace(const char* ptr, const char* end) {
+    resolve();
+    return scan_whitespace(ptr, end);
+}
+
+static const char* resolve_newline(const char* ptr, const char* end) {
+    resolve();
+    return scan_newline(ptr, end);
+}
+
+static const char* resolve_string(const char* ptr, const char* end) {
+    resolve();
+    return scan_string(ptr, end);
+}
+
+static const char* resolve_ascii(const char* ptr, const char* end) {
+    resolve();
+    return scan_ascii(ptr, end);
+}
+
+static bool resolve_utf8(const char* ptr, const char* end) {
+    resolve();
+    return scan_utf8(ptr, end);
+}
+
+scan_kernel scan_whitespace_kernel = resolve_whitespace;
+scan_kernel scan_newline_kernel = resolve_newline;
+scan_kernel scan_string_kernel = resolve_string;
+scan_kernel scan_ascii_kernel = resolve_ascii;
+scan_check scan_utf8_kernel = resolve_utf8;
+
+static void install(scan_kernel whitespace, scan_kernel newline, scan_kernel string,
+                    scan_kernel ascii, scan_check utf8) {
+    __atomic_store_n(&scan_whitespace_kernel, whitespace, __ATOMIC_RELAXED);
+    __atomic_store_n(&scan_newline_kernel, newline, __ATOMIC_RELAXED);
+    __atomic_store_n(&scan_string_kernel, string, __ATOMIC_RELAXED);
+    __atomic_store_n(&scan_ascii_kernel, ascii, __ATOMIC_RELAXED);
+    __atomic_store_n(&scan_utf8_kernel, utf8, __ATOMIC_RELAXED);
+}
+
+static void resolve(void) {
+#ifdef SCAN_X86
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2")) {
+        install(avx2_whitespace, avx2_newline, avx2_string, avx2_ascii, avx2_utf8);
+        return;
+    }
+    install(sse2_whitespace, sse2_newline, sse2_string, sse2_ascii, scalar_utf8);
+#else
+    install(scalar_whitespace, scalar_newline, scalar_string, scalar_ascii, scalar_utf8);
+#endif
+}
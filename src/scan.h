@@ -0,0 +1,55 @@
+//===--------------------------------------------------------------------------------------------===
+// scan.h - Vectorised scanning kernels used by the lexer's inner loops
+// This source is part of ParseC
+//
+// Copyright (c) 2018 Amy Parent <amy@amyparent.com>
+// Licensed under the MIT License
+// =^•.•^=
+//===--------------------------------------------------------------------------------------------===
+#ifndef _PARSEC_SCAN_
+#define _PARSEC_SCAN_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Each kernel scans [ptr, end) and returns a pointer to the first byte that stops it, or [end] if
+// there isn't any. The best implementation available (AVX2, SSE2 or plain C) is picked the first
+// time a kernel is called, and the kernels are called through pointers that any thread may be
+// replacing at the time: they're loaded atomically, which costs nothing more than a plain load.
+typedef const char* (*scan_kernel)(const char* ptr, const char* end);
+typedef bool (*scan_check)(const char* ptr, const char* end);
+
+extern scan_kernel scan_whitespace_kernel;
+extern scan_kernel scan_newline_kernel;
+extern scan_kernel scan_string_kernel;
+extern scan_kernel scan_ascii_kernel;
+extern scan_check scan_utf8_kernel;
+
+// Returns the first byte that isn't inline whitespace (' ', '\t', '\v', '\f', '\r' or NUL).
+static inline const char* scan_whitespace(const char* ptr, const char* end) {
+    return __atomic_load_n(&scan_whitespace_kernel, __ATOMIC_RELAXED)(ptr, end);
+}
+
+// Returns the first '\n'.
+static inline const char* scan_newline(const char* ptr, const char* end) {
+    return __atomic_load_n(&scan_newline_kernel, __ATOMIC_RELAXED)(ptr, end);
+}
+
+// Returns the first byte that can end (or has to be checked in) a string literal: a quote, a line
+// return or the start of a multibyte UTF-8 sequence.
+static inline const char* scan_string(const char* ptr, const char* end) {
+    return __atomic_load_n(&scan_string_kernel, __ATOMIC_RELAXED)(ptr, end);
+}
+
+// Returns the first byte that isn't ASCII.
+static inline const char* scan_ascii(const char* ptr, const char* end) {
+    return __atomic_load_n(&scan_ascii_kernel, __ATOMIC_RELAXED)(ptr, end);
+}
+
+// Unlike the other kernels, this one checks the whole range: it returns whether [ptr, end) is valid
+// UTF-8 (see utf8_checkSequence).
+static inline bool scan_utf8(const char* ptr, const char* end) {
+    return __atomic_load_n(&scan_utf8_kernel, __ATOMIC_RELAXED)(ptr, end);
+}
+
+#endif /* _PARSEC_SCAN_ */
@@ -0,0 +1,165 @@
+//===--------------------------------------------------------------------------------------------===
+// segment.c - Packed token storage for inputs bigger than 4GB
+// This source is part of ParseC
+//
+// Copyright (c) 2018 Amy Parent <amy@amyparent.com>
+// Licensed under the MIT License
+// =^•.•^=
+//===--------------------------------------------------------------------------------------------===
+#include <assert.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <parsec/parsec.h>
+
+#define SEGMENT_BATCH       1024
+#define SEGMENT_MIN_TOKENS  (4 * 1024)
+
+// MARK: - Splitting
+
+static bool segments_push(parsec_segments* segments, uint64_t* capacity, uint64_t base,
+                          uint64_t length) {
+    if(segments->count == *capacity) {
+        uint64_t grown = *capacity ? *capacity * 2 : 16;
+        parsec_segment* array = realloc(segments->segments, grown * sizeof(parsec_segment));
+        if(!array) return false;
+        segments->segments = array;
+        *capacity = grown;
+    }
+    segments->segments[segments->count++] = (parsec_segment){
+        .base = base,
+        .length = length,
+        .tokens = NULL,
+        .count = 0,
+        .capacity = 0,
+        .result = PARSEC_SUCCESS,
+    };
+    return true;
+}
+
+// Each segment ends after the last line return that still fits in it. Tokens never span lines,
+// so no token is ever cut in two.
+static const char* segments_cut(const char* start, const char* end, uint64_t size) {
+    if((uint64_t)(end - start) <= size) return end;
+    const char* cut = start + size;
+    while(cut > start && cut[-1] != '\n') cut -= 1;
+    return cut;
+}
+
+// MARK: - Lexing
+
+// A segment is lexed as an input of its own, so the packed offsets are relative to its base.
+// Tokens go through a small buffer, like parsec_cache_save does, so they can be packed on the way.
+static parsec_result segment_lex(parsec* region, parsec_segment* segment) {
+    parsec_token buffer[SEGMENT_BATCH];
+    
+    for(;;) {
+        region->next_token = 0;
+        parsec_result result = parsec_lex(region, buffer, SEGMENT_BATCH);
+        // An invalid token still takes a slot, which we don't want to keep around.
+        uint64_t count = region->next_token - (result == PARSEC_INVALID ? 1 : 0);
+        
+        if(segment->count + count > segment->capacity) {
+            // The first allocation is sized from an estimate, and later ones double the storage.
+            uint64_t needed = segment->count + count;
+            uint64_t capacity = segment->capacity ? segment->capacity * 2
+                                                  : needed + parsec_estimate_tokens(region);
+            if(capacity < needed) capacity = needed;
+            if(capacity < SEGMENT_MIN_TOKENS) capacity = SEGMENT_MIN_TOKENS;
+            parsec_packed_token* tokens = realloc(segment->tokens,
+                                                  capacity * sizeof(parsec_packed_token));
+            if(!tokens) return PARSEC_NOALLOC;
+            segment->tokens = tokens;
+            segment->capacity = capacity;
+        }
+        
+        for(uint64_t i = 0; i < count; ++i) {
+            const parsec_token* token = &buffer[i];
+            if(token->length > PARSEC_PACKED_MAX_LENGTH) {
+                region->head = token->start;
+                return PARSEC_OVERFLOW;
+            }
+            parsec_packed_token* packed = &segment->tokens[segment->count++];
+            packed->offset = (uint32_t)(token->start - region->data);
+            packed->info = token->length | ((uint32_t)(uint8_t)token->kind << 24);
+        }
+        if(result != PARSEC_NOMEM) return result < 0 ? result : PARSEC_SUCCESS;
+    }
+}
+
+static parsec_result segment_run(const parsec* parser, parsec_segment* segment, parsec* region) {
+    *region = *parser;
+    region->data = parser->data + segment->base;
+    region->head = region->data;
+    region->end = region->data + segment->length;
+#ifdef PARSEC_STATS
+    parsec_stats_reset(region);
+#endif
+    
+    segment->count = 0;
+    segment->result = segment_lex(region, segment);
+    return segment->result;
+}
+
+// MARK: - Public API implementation
+
+parsec_result parsec_segments_init(parsec_segments* segments, const parsec* parser,
+                                   uint64_t segment_size) {
+    assert(segments && "Invalid segments given");
+    assert(parser && "Invalid ParseC status given");
+    
+    segments->segments = NULL;
+    segments->count = 0;
+    if(!segment_size || segment_size > PARSEC_SEGMENT_MAX) segment_size = PARSEC_SEGMENT_MAX;
+    
+    uint64_t capacity = 0;
+    const char* start = parser->head;
+    while(start < parser->end) {
+        const char* cut = segments_cut(start, parser->end, segment_size);
+        parsec_result result = PARSEC_SUCCESS;
+        if(cut == start) result = PARSEC_OVERFLOW;
+        else if(!segments_push(segments, &capacity, start - parser->data, cut - start))
+            result = PARSEC_NOALLOC;
+        
+        if(result != PARSEC_SUCCESS) {
+            parsec_segments_deinit(segments);
+            return result;
+        }
+        start = cut;
+    }
+    return PARSEC_SUCCESS;
+}
+
+void parsec_segments_deinit(parsec_segments* segments) {
+    assert(segments && "Invalid segments given");
+    for(uint64_t i = 0; i < segments->count; ++i) free(segments->segments[i].tokens);
+    free(segments->segments);
+    segments->segments = NULL;
+    segments->count = 0;
+}
+
+parsec_result parsec_lex_segment(const parsec* parser, parsec_segments* segments, uint64_t index) {
+    assert(parser && "Invalid ParseC status given");
+    assert(segments && index < segments->count && "Invalid segment given");
+    parsec region;
+    return segment_run(parser, &segments->segments[index], &region);
+}
+
+parsec_result parsec_lex_segments(parsec* parser, parsec_segments* segments) {
+    assert(parser && "Invalid ParseC status given");
+    assert(segments && "Invalid segments given");
+    
+    for(uint64_t i = 0; i < segments->count; ++i) {
+        parsec region;
+        parsec_result result = segment_run(parser, &segments->segments[i], &region);
+#ifdef PARSEC_STATS
+        parsec_stats_merge(&parser->stats, &region.stats);
+#endif
+        if(result != PARSEC_SUCCESS) {
+            parser->head = region.head;
+            return result;
+        }
+    }
+    parser->head = parser->end;
+    return PARSEC_SUCCESS;
+}
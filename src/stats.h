@@ -0,0 +1,72 @@
+//===--------------------------------------------------------------------------------------------===
+// stats.h - Opt-in lexer statistics and sampled timings
+// This source is part of ParseC
+//
+// Copyright (c) 2018 Amy Parent <amy@amyparent.com>
+// Licensed under the MIT License
+// =^•.•^=
+//===--------------------------------------------------------------------------------------------===
+#ifndef _PARSEC_STATS_
+#define _PARSEC_STATS_
+
+#include <parsec/parsec.h>
+
+// Statistics are only compiled in when PARSEC_STATS is defined (see PARSEC_ENABLE_STATS in
+// CMake). Otherwise, every macro below expands to nothing.
+
+#ifdef PARSEC_STATS
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <x86intrin.h>
+static inline uint64_t stats_clock(void) { return __rdtsc(); }
+#else
+#include <time.h>
+static inline uint64_t stats_clock(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+#endif
+
+// Only one call in PARSEC_STATS_SAMPLE is timed, so reading the clock doesn't dominate the cost
+// of the short routines we're measuring.
+static inline uint64_t stats_begin(parsec* parser, parsec_stat_section section) {
+    if(parser->stats.calls[section]++ & (PARSEC_STATS_SAMPLE - 1)) return 0;
+    return stats_clock();
+}
+
+static inline void stats_end(parsec* parser, parsec_stat_section section, uint64_t start) {
+    if(!start) return;
+    parser->stats.cycles[section] += stats_clock() - start;
+    parser->stats.samples[section] += 1;
+}
+
+// Text the scanners skip over in bulk is counted afterwards: every byte that isn't a continuation
+// byte starts a character (or an invalid sequence, which next_char also counts one at a time).
+static inline void stats_non_ascii(parsec* parser, const char* start, const char* end) {
+    for(const char* ptr = start; ptr < end; ++ptr) {
+        uint8_t byte = (uint8_t)*ptr;
+        parser->stats.non_ascii += byte >= 0x80 && (byte & 0xc0) != 0x80;
+    }
+}
+
+#define STAT_BEGIN(parser, section)     uint64_t stat_start = stats_begin((parser), (section))
+#define STAT_END(parser, section)       stats_end((parser), (section), stat_start)
+#define STAT_TOKEN(parser, kind, size)  do {                                                        \
+                                            (parser)->stats.tokens[(kind) + 1] += 1;                \
+                                            (parser)->stats.bytes[(kind) + 1] += (size);            \
+                                        } while(0)
+#define STAT_NON_ASCII(parser)          ((parser)->stats.non_ascii += 1)
+#define STAT_NON_ASCII_RANGE(parser, start, end) stats_non_ascii((parser), (start), (end))
+
+#else
+
+#define STAT_BEGIN(parser, section)
+#define STAT_END(parser, section)
+#define STAT_TOKEN(parser, kind, size)
+#define STAT_NON_ASCII(parser)
+#define STAT_NON_ASCII_RANGE(parser, start, end) ((void)(start))
+
+#endif /* PARSEC_STATS */
+
+#endif /* _PARSEC_STATS_ */
@@ -0,0 +1,100 @@
+//===--------------------------------------------------------------------------------------------===
+// stream.c - Lexing input that arrives in chunks
+// This source is part of ParseC
+//
+// Copyright (c) 2018 Amy Parent <amy@amyparent.com>
+// Licensed under the MIT License
+// =^•.•^=
+//===--------------------------------------------------------------------------------------------===
+#include <assert.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <parsec/parsec.h>
+
+#define STREAM_MIN_CAPACITY (64 * 1024)
+
+// The parser's range is always [buffer, end of the last complete line]: bytes up to its end were
+// checked for UTF-8 (and searched for line returns) when they were first lexed.
+
+// Moves whatever hasn't been lexed yet to the start of the buffer, and appends [chunk] after it.
+// Resuming after PARSEC_NOMEM appends nothing, and leaves everything where it is.
+static bool stream_append(parsec_stream* stream, const char* chunk, uint64_t length) {
+    if(!length) return true;
+    uint64_t consumed = stream->buffer ? stream->parser.head - stream->buffer : 0;
+    uint64_t lexed = stream->buffer ? stream->parser.end - stream->buffer - consumed : 0;
+    uint64_t pending = stream->size - consumed;
+    if(consumed && pending) memmove(stream->buffer, stream->parser.head, pending);
+    stream->size = pending;
+    stream->parser.head = stream->buffer;
+    stream->parser.end = stream->buffer + lexed;
+    
+    if(pending + length > stream->capacity) {
+        uint64_t capacity = stream->capacity ? stream->capacity : STREAM_MIN_CAPACITY;
+        while(capacity < pending + length) capacity *= 2;
+        char* buffer = realloc(stream->buffer, capacity);
+        if(!buffer) return false;
+        stream->buffer = buffer;
+        stream->capacity = capacity;
+        stream->parser.head = buffer;
+        stream->parser.end = buffer + lexed;
+    }
+    memcpy(stream->buffer + stream->size, chunk, length);
+    stream->size += length;
+    stream->parser.data = stream->buffer;
+    return true;
+}
+
+// Extends the parser's range to [limit] and lexes what's left of it. Only the new lines need to be
+// checked: the rest of the range was valid UTF-8 if the parser still says so, or if the parts
+// that weren't have been lexed since.
+static parsec_result stream_lex(parsec_stream* stream, const char* limit,
+                                parsec_token* tokens, uint64_t token_count) {
+    if(!stream->buffer) return 0;
+    parsec* parser = &stream->parser;
+    if(limit > parser->end) {
+        bool valid = parser->validated || parser->head == parser->end;
+        parser->validated = valid && parsec_utf8_valid(parser->end, limit - parser->end);
+        parser->end = limit;
+    }
+    parser->next_token = 0;
+    return parsec_lex(parser, tokens, token_count);
+}
+
+void parsec_stream_init(parsec_stream* stream, char comment_char) {
+    assert(stream && "Invalid ParseC stream given");
+    parsec_init(&stream->parser, "", 0, comment_char);
+    stream->buffer = NULL;
+    stream->size = 0;
+    stream->capacity = 0;
+}
+
+void parsec_stream_deinit(parsec_stream* stream) {
+    assert(stream && "Invalid ParseC stream given");
+    free(stream->buffer);
+    stream->buffer = NULL;
+    stream->size = stream->capacity = 0;
+}
+
+parsec_result parsec_feed(parsec_stream* stream, const char* chunk, uint64_t length,
+                          parsec_token* tokens, uint64_t token_count) {
+    assert(stream && "Invalid ParseC stream given");
+    assert((chunk || !length) && "Invalid chunk given");
+    if(!stream_append(stream, chunk, length)) return PARSEC_NOALLOC;
+    
+    if(!stream->buffer) return 0;
+    
+    // Tokens never span lines, so everything up to the last line return can be lexed right away.
+    // Past the end of the parser's range, there can only be one in the new chunk.
+    const char* limit = stream->buffer + stream->size;
+    const char* floor = limit - length > stream->parser.end ? limit - length : stream->parser.end;
+    while(limit > floor && limit[-1] != '\n') limit -= 1;
+    if(limit == floor) limit = stream->parser.end;
+    return stream_lex(stream, limit, tokens, token_count);
+}
+
+parsec_result parsec_finish(parsec_stream* stream, parsec_token* tokens, uint64_t token_count) {
+    assert(stream && "Invalid ParseC stream given");
+    if(!stream_append(stream, NULL, 0)) return PARSEC_NOALLOC;
+    return stream_lex(stream, stream->buffer + stream->size, tokens, token_count);
+}
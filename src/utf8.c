@@ -34,7 +34,7 @@ codepoint_t utf8_getCodepoint(const char* data, uint64_t length) {
     }
     else { return -1; }
     
-    if(remaining > length + 1) { return -1; }
+    if(remaining >= length) { return -1; }
     
     while(remaining > 0) {
         data += 1;
@@ -45,6 +45,33 @@ codepoint_t utf8_getCodepoint(const char* data, uint64_t length) {
     return point;
 }
 
+int8_t utf8_checkSequence(const char* data, uint64_t length) {
+    const uint8_t* bytes = (const uint8_t*)data;
+    uint8_t lead = bytes[0];
+    int8_t size = 0;
+    // The second byte has a narrower range after some leads, to rule out overlong forms,
+    // surrogates and codepoints past U+10FFFF.
+    uint8_t low = 0x80;
+    uint8_t high = 0xbf;
+    
+    if(lead < 0x80) { return 1; }
+    else if(IN_RANGE(lead, 0xc2, 0xdf)) { size = 2; }
+    else if(lead == 0xe0) { size = 3; low = 0xa0; }
+    else if(lead == 0xed) { size = 3; high = 0x9f; }
+    else if(IN_RANGE(lead, 0xe1, 0xef)) { size = 3; }
+    else if(lead == 0xf0) { size = 4; low = 0x90; }
+    else if(lead == 0xf4) { size = 4; high = 0x8f; }
+    else if(IN_RANGE(lead, 0xf1, 0xf3)) { size = 4; }
+    else { return -1; }
+    
+    if(size > length) { return -1; }
+    if(bytes[1] < low || bytes[1] > high) { return -1; }
+    for(int8_t i = 2; i < size; ++i) {
+        if((bytes[i] & 0xc0) != 0x80) { return -1; }
+    }
+    return size;
+}
+
 
 // 0x00000000 - 0x0000007F:
 //        0xxxxxxx
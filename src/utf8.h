@@ -22,6 +22,28 @@ typedef int32_t codepoint_t;
 
 codepoint_t utf8_getCodepoint(const char* data, uint64_t length);
 
+// Returns the size of the sequence at [data] if it is valid UTF-8 (no overlong forms, surrogates
+// or codepoints above U+10FFFF), -1 otherwise.
+int8_t utf8_checkSequence(const char* data, uint64_t length);
+
+// Size of a sequence from its first byte, for input that has been checked already.
+static inline int8_t utf8_leadSize(uint8_t lead) {
+    return lead < 0x80 ? 1 : lead < 0xe0 ? 2 : lead < 0xf0 ? 3 : 4;
+}
+
+// Decodes a sequence that has been checked already, without looking at it again.
+static inline codepoint_t utf8_decodeValid(const char* data) {
+    const uint8_t* bytes = (const uint8_t*)data;
+    switch(utf8_leadSize(bytes[0])) {
+    case 1: return bytes[0];
+    case 2: return ((bytes[0] & 0x1f) << 6) | (bytes[1] & 0x3f);
+    case 3: return ((bytes[0] & 0x0f) << 12) | ((bytes[1] & 0x3f) << 6) | (bytes[2] & 0x3f);
+    default: break;
+    }
+    return ((bytes[0] & 0x07) << 18) | ((bytes[1] & 0x3f) << 12)
+         | ((bytes[2] & 0x3f) << 6) | (bytes[3] & 0x3f);
+}
+
 // writes [codepoint] to a [data]. If [point] takes more bytes than [length], 
 // returns -1. Otherwise, returns the number of bytes written to [data].
 int8_t utf8_writeCodepoint(codepoint_t point, char* data, uint64_t length);
@@ -0,0 +1,121 @@
+//===--------------------------------------------------------------------------------------------===
+// batch_test.c - parsec_lex_batch against parsec_lex on each of its inputs
+// This source is part of ParseC
+//
+// Copyright (c) 2018 Amy Parent <amy@amyparent.com>
+// Licensed under the MIT License
+// =^•.•^=
+//===--------------------------------------------------------------------------------------------===
+#include "test.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <parsec/parsec.h>
+
+// Inputs bigger than a few MB are split into pieces that are lexed on their own, and stitched back
+// together. Small inputs are numerous enough for workers to have to steal from each other.
+#define BIG_SIZE        (3 * 1024 * 1024 + 12345)
+#define SMALL_COUNT     40
+
+static char* make_text(uint64_t size, const char* bad, double bad_at, uint64_t* length) {
+    char* text = malloc(size + 256);
+    uint64_t offset = bad ? (uint64_t)(size * bad_at) : UINT64_MAX;
+    uint64_t written = 0;
+    for(int line = 0; written < size; ++line) {
+        const char* format = line % 3 ? "KEY_%d %d -%d.5 'str' @\n" : "# comment %d\n";
+        written += sprintf(text + written, format, line, line, line);
+        if(bad && written >= offset) {
+            written += sprintf(text + written, "%s", bad);
+            offset = UINT64_MAX;
+        }
+    }
+    *length = written;
+    return text;
+}
+
+static void write_file(const char* path, const char* data, uint64_t length) {
+    FILE* file = fopen(path, "wb");
+    CHECK(file && fwrite(data, 1, length, file) == length);
+    if(file) fclose(file);
+}
+
+// Lexes [item]'s input on its own, and checks the batch came up with the same result, tokens and
+// final position. Tokens are compared by offset, since files are mapped once per batch.
+static bool same_as_sequential(const parsec_batch_item* item) {
+    parsec parser;
+    if(item->path) {
+        parsec_result opened = parsec_open_file(&parser, item->path, '#');
+        if(opened != PARSEC_SUCCESS) return item->result == opened;
+    } else {
+        parser = item->parser;
+        parser.head = parser.data;
+        parser.next_token = 0;
+    }
+    
+    uint64_t capacity = (parser.end - parser.data) + 1;
+    parsec_token* tokens = malloc(capacity * sizeof(parsec_token));
+    parsec_result result = parsec_lex(&parser, tokens, capacity);
+    uint64_t filled = parser.next_token - (result == PARSEC_INVALID ? 1 : 0);
+    
+    bool same = item->result == result && item->count == parser.next_token
+             && item->parser.head - item->parser.data == parser.head - parser.data;
+    for(uint64_t i = 0; same && i < filled; ++i) {
+        same = item->tokens[i].kind == tokens[i].kind && item->tokens[i].length == tokens[i].length
+            && item->tokens[i].start - item->parser.data == tokens[i].start - parser.data;
+    }
+    if(!same) {
+        fprintf(stderr, "%s: result %d/%d, %llu/%llu tokens\n", item->path ? item->path : "buffer",
+                result, item->result, (unsigned long long)parser.next_token,
+                (unsigned long long)item->count);
+    }
+    free(tokens);
+    if(item->path) parsec_close_file(&parser);
+    return same;
+}
+
+int main(void) {
+    uint64_t big_length, bad_length, small_length, early_length;
+    char* big = make_text(BIG_SIZE, NULL, 0, &big_length);
+    char* bad = make_text(BIG_SIZE, "bad 1.e5\n", 0.7, &bad_length);
+    char* small = make_text(2000, NULL, 0, &small_length);
+    char* early = make_text(BIG_SIZE, "'unterminated\n", 0.05, &early_length);
+    write_file("batch_big.txt", big, big_length);
+    write_file("batch_bad.txt", early, early_length);
+    write_file("batch_small.txt", small, small_length);
+    write_file("batch_empty.txt", "", 0);
+    
+    enum { FIXED = 9, ITEMS = FIXED + SMALL_COUNT };
+    parsec_batch_item items[ITEMS];
+    memset(items, 0, sizeof(items));
+    const char* paths[FIXED] = {
+        NULL, NULL, NULL, NULL,
+        "batch_big.txt", "batch_bad.txt", "batch_small.txt", "batch_empty.txt", "batch_missing.txt",
+    };
+    const char* buffers[FIXED] = { big, bad, small, "" };
+    const uint64_t lengths[FIXED] = { big_length, bad_length, small_length, 0 };
+    
+    const unsigned threads[] = { 1, 2, 4, 0 };
+    for(size_t t = 0; t < sizeof(threads) / sizeof(threads[0]); ++t) {
+        for(int i = 0; i < ITEMS; ++i) {
+            items[i].path = i < FIXED ? paths[i] : NULL;
+            if(items[i].path) continue;
+            const char* data = i < FIXED ? buffers[i] : small + (i % 7) * 10;
+            uint64_t length = i < FIXED ? lengths[i] : small_length - (i % 7) * 10;
+            parsec_init(&items[i].parser, data, length, '#');
+        }
+        CHECK(parsec_lex_batch(items, ITEMS, '#', threads[t]) == PARSEC_SUCCESS);
+        for(int i = 0; i < ITEMS; ++i) CHECK(same_as_sequential(&items[i]));
+        CHECK(items[1].result == PARSEC_INVALID);
+        CHECK(items[5].result == PARSEC_INVALID);
+        CHECK(items[7].result == 0);
+        CHECK(items[8].result == PARSEC_NOFILE);
+        parsec_batch_free(items, ITEMS);
+    }
+    
+    free(big);
+    free(bad);
+    free(small);
+    free(early);
+    TEST_END();
+}
@@ -0,0 +1,177 @@
+//===--------------------------------------------------------------------------------------------===
+// cache_test.c - Token caches: round trips, and caches that must not load
+// This source is part of ParseC
+//
+// Copyright (c) 2018 Amy Parent <amy@amyparent.com>
+// Licensed under the MIT License
+// =^•.•^=
+//===--------------------------------------------------------------------------------------------===
+#include "test.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <parsec/parsec.h>
+
+#define CACHE_PATH      "cache_test.cache"
+
+// The cache header is 48 bytes, and the packed tokens follow it.
+#define HEADER_SIZE     48
+
+static char* make_text(uint64_t* length) {
+    char* text = malloc(256 * 1024);
+    uint64_t size = 0;
+    for(int i = 0; i < 5000; ++i) {
+        size += sprintf(text + size, "KEY_%d %d -%d.5e3 'str %d' @ # c\n", i, i, i, i);
+    }
+    *length = size;
+    return text;
+}
+
+// Checks [cache] holds the same tokens and values as lexing [parser]'s input.
+static bool same_as_lexed(const parsec_token_cache* cache, const parsec* parser,
+                          const parsec_token* tokens, const parsec_value* values,
+                          uint64_t count) {
+    if(cache->count != count || (cache->values == NULL) != (values == NULL)) return false;
+    for(uint64_t i = 0; i < count; ++i) {
+        parsec_packed_token packed = cache->tokens[i];
+        if(parsec_packed_kind(packed) != tokens[i].kind
+           || parsec_packed_length(packed) != tokens[i].length
+           || parsec_packed_start(parser, packed) != tokens[i].start) return false;
+        if(values && memcmp(&cache->values[i], &values[i], sizeof(parsec_value))) return false;
+    }
+    return true;
+}
+
+static parsec_result load(const parsec* parser) {
+    parsec_token_cache cache;
+    parsec_result result = parsec_cache_load(&cache, CACHE_PATH, parser);
+    CHECK(result == PARSEC_SUCCESS || cache.mapping == NULL);
+    parsec_cache_close(&cache);
+    return result;
+}
+
+// Overwrites [size] bytes of the cache file at [offset], or truncates it there if [data] is NULL.
+static void tamper(uint64_t offset, const void* data, uint64_t size) {
+    FILE* file = fopen(CACHE_PATH, "rb");
+    char* contents = malloc(1024 * 1024 * 4);
+    uint64_t length = fread(contents, 1, 1024 * 1024 * 4, file);
+    fclose(file);
+    if(data) {
+        memcpy(contents + offset, data, size);
+    } else {
+        length = offset;
+    }
+    file = fopen(CACHE_PATH, "wb");
+    fwrite(contents, 1, length, file);
+    fclose(file);
+    free(contents);
+}
+
+static void test_round_trip(char* text, uint64_t length) {
+    parsec_token* tokens = malloc((length + 1) * sizeof(parsec_token));
+    parsec_value* values = malloc((length + 1) * sizeof(parsec_value));
+    parsec parser;
+    parsec_init(&parser, text, length, '#');
+    parsec_result count = parsec_lex_values(&parser, tokens, values, length + 1);
+    CHECK(count >= 0);
+    
+    for(int with_values = 0; with_values < 2; ++with_values) {
+        const parsec_value* saved = with_values ? values : NULL;
+        CHECK(parsec_cache_save(&parser, tokens, saved, count, CACHE_PATH) == PARSEC_SUCCESS);
+        parsec_token_cache cache;
+        CHECK(parsec_cache_load(&cache, CACHE_PATH, &parser) == PARSEC_SUCCESS);
+        CHECK(same_as_lexed(&cache, &parser, tokens, saved, count));
+        parsec_cache_close(&cache);
+        CHECK(cache.mapping == NULL && cache.count == 0);
+    }
+    free(values);
+    free(tokens);
+}
+
+static void test_stale(char* text, uint64_t length) {
+    parsec_token* tokens = malloc((length + 1) * sizeof(parsec_token));
+    parsec parser;
+    parsec_init(&parser, text, length, '#');
+    parsec_result count = parsec_lex(&parser, tokens, length + 1);
+    CHECK(parsec_cache_save(&parser, tokens, NULL, count, CACHE_PATH) == PARSEC_SUCCESS);
+    CHECK(load(&parser) == PARSEC_SUCCESS);
+    
+    // The same input with a single byte changed, or one byte shorter.
+    text[length / 2] ^= 1;
+    CHECK(load(&parser) == PARSEC_INVALID);
+    text[length / 2] ^= 1;
+    parsec_init(&parser, text, length - 1, '#');
+    CHECK(load(&parser) == PARSEC_INVALID);
+    
+    // The same input, lexed with another comment character or dialect.
+    parsec_init(&parser, text, length, ';');
+    CHECK(load(&parser) == PARSEC_INVALID);
+    parsec_init(&parser, text, length, '#');
+    parsec_set_dialect(&parser, PARSEC_DIALECT_C);
+    CHECK(load(&parser) == PARSEC_INVALID);
+    parsec_set_dialect(&parser, PARSEC_DIALECT_DEFAULT);
+    CHECK(load(&parser) == PARSEC_SUCCESS);
+    free(tokens);
+}
+
+static void test_tampered(char* text, uint64_t length) {
+    parsec_token* tokens = malloc((length + 1) * sizeof(parsec_token));
+    parsec parser;
+    parsec_init(&parser, text, length, '#');
+    parsec_result count = parsec_lex(&parser, tokens, length + 1);
+    
+    // Wrong magic, a token pointing past the end of the source, a truncated token array, and a
+    // file too short to even hold a header.
+    const uint32_t far = 0xfffffff0;
+    const struct { uint64_t offset; const void* data; uint64_t size; } edits[] = {
+        { 0, "XXXX", 4 },
+        { HEADER_SIZE + 8 * 10, &far, sizeof(far) },
+        { HEADER_SIZE + 8 * 10, NULL, 0 },
+        { HEADER_SIZE - 1, NULL, 0 },
+        { 0, NULL, 0 },
+    };
+    for(size_t i = 0; i < sizeof(edits) / sizeof(edits[0]); ++i) {
+        CHECK(parsec_cache_save(&parser, tokens, NULL, count, CACHE_PATH) == PARSEC_SUCCESS);
+        tamper(edits[i].offset, edits[i].data, edits[i].size);
+        CHECK(load(&parser) == PARSEC_INVALID);
+    }
+    free(tokens);
+}
+
+static void test_errors(void) {
+    static const char source[] = "KEY 1 2\n";
+    parsec parser;
+    parsec_token tokens[8];
+    parsec_init(&parser, source, 8, '#');
+    parsec_result count = parsec_lex(&parser, tokens, 8);
+    
+    remove(CACHE_PATH);
+    CHECK(load(&parser) == PARSEC_NOFILE);
+    CHECK(parsec_cache_save(&parser, tokens, NULL, count, "no/such/dir/x.cache") == PARSEC_NOFILE);
+    
+    // Tokens that don't fit in packed tokens can't be saved, and leave no file behind.
+    tokens[1].length = PARSEC_PACKED_MAX_LENGTH + 1;
+    CHECK(parsec_cache_save(&parser, tokens, NULL, count, CACHE_PATH) == PARSEC_OVERFLOW);
+    CHECK(load(&parser) == PARSEC_NOFILE);
+    
+    // An empty input has an empty cache.
+    parsec_init(&parser, "", 0, '#');
+    CHECK(parsec_cache_save(&parser, NULL, NULL, 0, CACHE_PATH) == PARSEC_SUCCESS);
+    parsec_token_cache cache;
+    CHECK(parsec_cache_load(&cache, CACHE_PATH, &parser) == PARSEC_SUCCESS);
+    CHECK(cache.count == 0 && cache.values == NULL);
+    parsec_cache_close(&cache);
+}
+
+int main(void) {
+    uint64_t length;
+    char* text = make_text(&length);
+    test_round_trip(text, length);
+    test_stale(text, length);
+    test_tampered(text, length);
+    test_errors();
+    remove(CACHE_PATH);
+    free(text);
+    TEST_END();
+}
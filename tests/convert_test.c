@@ -0,0 +1,228 @@
+//===--------------------------------------------------------------------------------------------===
+// convert_test.c - Number conversion functions, against strtod
+// This source is part of ParseC
+//
+// Copyright (c) 2018 Amy Parent <amy@amyparent.com>
+// Licensed under the MIT License
+// =^•.•^=
+//===--------------------------------------------------------------------------------------------===
+#include "test.h"
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <parsec/parsec.h>
+
+#define TEST_DOUBLES    200000
+#define TEST_INTEGERS   200000
+
+static uint64_t seed = 0x9e3779b97f4a7c15ull;
+
+static uint64_t next_random(void) {
+    seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+    return seed >> 11;
+}
+
+// MARK: - Floating point conversion
+
+// Exact halfway cases, the fast path's limits (2^53, 10^22), subnormals and the largest finite
+// double, numbers with more digits than the mantissa keeps, and 'd' exponents.
+static const char* const doubles[] = {
+    "0", "-0", "0.0", "-0.0", "+0e10", "1", "-1", ".5", "5.", "-.25e1", "1.5d3", "2.5D-3",
+    "9007199254740992", "9007199254740993", "9007199254740994", "9007199254740995",
+    "18014398509481985", "1e22", "1e23", "-1e-22", "1e-23", "123456789012345e10",
+    "4.9e-324", "2.4703282292062327e-324", "2.4703282292062328e-324", "5e-324", "1e-400",
+    "2.2250738585072011e-308", "2.2250738585072014e-308", "1.7976931348623157e308",
+    "1.7976931348623158e308", "1.7976931348623159e308", "1e309", "-1e400",
+    "0.1", "0.2", "0.3", "3.14159265358979323846264338327950288", "1234567890123456789",
+    "12345678901234567890", "12345678901234567890123456789e-20", "9999999999999999999",
+    "0.00000000000000000000000000000000000000001",
+    "100000000000000000000000000000000000000000000000000000000000001e-60",
+    "7.2057594037927933e16", "8.98846567431158e307", "1e0000000000000000000000000000000001",
+    "1e-00000000000000000000000000000000001", "0e99999999999",
+};
+
+// What strtod makes of the number in [ptr, ptr+length), with 'd' exponents as 'e' exponents.
+static double reference_double(const char* ptr, uint64_t length) {
+    char* text = malloc(length + 1);
+    for(uint64_t i = 0; i < length; ++i) text[i] = ptr[i] == 'd' || ptr[i] == 'D' ? 'e' : ptr[i];
+    text[length] = '\0';
+    double value = strtod(text, NULL);
+    free(text);
+    return value;
+}
+
+static bool check_double(const char* ptr, uint64_t length) {
+    double expected = reference_double(ptr, length);
+    double value = parsec_str_double(ptr, length);
+    if(!memcmp(&expected, &value, sizeof(double))) return true;
+    fprintf(stderr, "'%.*s': %.17g, expected %.17g\n", (int)length, ptr, value, expected);
+    return false;
+}
+
+// A random number with up to [digits] digits of mantissa, a decimal point anywhere in it, and an
+// exponent that reaches past both ends of the range of doubles.
+static int random_decimal(char* out, int digits) {
+    int size = 0;
+    uint64_t shape = next_random();
+    if(shape & 1) out[size++] = shape & 2 ? '-' : '+';
+    int count = 1 + (int)(next_random() % digits);
+    int point = (shape & 4) ? (int)(next_random() % (count + 1)) : -1;
+    for(int i = 0; i < count; ++i) {
+        if(i == point) out[size++] = '.';
+        out[size++] = '0' + next_random() % 10;
+    }
+    if(point == count) out[size++] = '0';
+    if(shape & 8) size += sprintf(out + size, "%c%d", "eEdD"[shape >> 4 & 3],
+                                  (int)(next_random() % 700) - 360);
+    return size;
+}
+
+static void test_doubles(void) {
+    for(size_t i = 0; i < sizeof(doubles) / sizeof(doubles[0]); ++i) {
+        CHECK(check_double(doubles[i], strlen(doubles[i])));
+    }
+    
+    // Only [length] bytes are read: what follows doesn't change the value.
+    CHECK(parsec_str_double("1.2345", 3) == 1.2);
+    CHECK(parsec_str_double("15e10", 2) == 15.0);
+    CHECK(parsec_str_double("9007199254740993", 15) == 900719925474099.0);
+    
+    // Numbers longer than the slow path's stack buffer.
+    char text[512];
+    memset(text, '1', 400);
+    text[200] = '.';
+    CHECK(check_double(text, 400));
+    strcpy(text + 400, "e-250");
+    CHECK(check_double(text, 405));
+    
+    int failures = 0;
+    for(int i = 0; i < TEST_DOUBLES && failures < 10; ++i) {
+        // Short numbers take the fast path, long ones the slow one, and random doubles printed with
+        // 1 to 17 digits hit every part of the range.
+        int length;
+        if(i % 3 == 2) {
+            uint64_t bits = next_random() << 11 | (next_random() & 0x7ff);
+            double value;
+            memcpy(&value, &bits, sizeof(double));
+            if(value != value || value - value != 0) continue;
+            length = sprintf(text, "%.*g", 1 + (int)(next_random() % 17), value);
+        } else {
+            length = random_decimal(text, i % 3 ? 40 : 15);
+        }
+        if(!check_double(text, length)) failures += 1;
+    }
+    CHECK(failures == 0);
+}
+
+// MARK: - Integer conversion
+
+// Both sides of every limit, one digit over them, leading zeroes, and strings that aren't integers
+// at all, including ones that only go wrong in the part parsed eight digits at a time.
+static const char* const integers[] = {
+    "", "+", "-", "0", "-0", "+0", "7", "-7", "+7", "00000000000000000000000000001",
+    "2147483647", "2147483648", "-2147483648", "-2147483649", "4294967296",
+    "9223372036854775807", "9223372036854775808", "-9223372036854775808", "-9223372036854775809",
+    "92233720368547758070", "-92233720368547758080", "000000000009223372036854775807",
+    "18446744073709551615", "18446744073709551616", "184467440737095516150",
+    "99999999999999999999", "100000000000000000000", "-18446744073709551615",
+    "1 ", " 1", "1a", "--1", "+-1", "-+1", "0x10", "1.0", "1e5", "12345678a1234567",
+    "1234567812345678x", "1234567:", "/1234567", "123456781234567812345678",
+};
+
+// Checks the syntax strtoll and strtoull are more lenient about: an optional sign (only '+' if
+// [is_signed] is false) and at least one digit, with nothing else around them.
+static bool is_integer(const char* text, bool is_signed) {
+    if(*text == '+' || (is_signed && *text == '-')) text++;
+    if(!*text) return false;
+    for(; *text; ++text) {
+        if(*text < '0' || *text > '9') return false;
+    }
+    return true;
+}
+
+static bool check_integer(const char* text) {
+    uint64_t length = strlen(text);
+    bool ok = true;
+    
+    int64_t value = 42;
+    parsec_result result = parsec_str_int64(text, length, &value);
+    errno = 0;
+    long long expected = strtoll(text, NULL, 10);
+    parsec_result want = !is_integer(text, true) ? PARSEC_INVALID
+                       : errno == ERANGE ? PARSEC_OVERFLOW : PARSEC_SUCCESS;
+    ok = ok && result == want && value == (want == PARSEC_SUCCESS ? expected : 42);
+    
+    int32_t clamped = want == PARSEC_INVALID ? 0
+                    : expected < INT32_MIN ? INT32_MIN
+                    : expected > INT32_MAX ? INT32_MAX : (int32_t)expected;
+    ok = ok && parsec_str_int(text, length) == clamped;
+    
+    uint64_t unsigned_value = 42;
+    result = parsec_str_uint64(text, length, &unsigned_value);
+    errno = 0;
+    unsigned long long unsigned_expected = strtoull(text, NULL, 10);
+    want = !is_integer(text, false) ? PARSEC_INVALID
+         : errno == ERANGE ? PARSEC_OVERFLOW : PARSEC_SUCCESS;
+    ok = ok && result == want
+            && unsigned_value == (want == PARSEC_SUCCESS ? unsigned_expected : 42);
+            
+    if(!ok) fprintf(stderr, "'%s'\n", text);
+    return ok;
+}
+
+// Random digits, numbers a few units away from a limit, and numbers with one character that
+// isn't a digit, with or without a sign.
+static void random_integer(char* out) {
+    static const uint64_t limits[] = {
+        INT32_MAX, (uint64_t)INT32_MAX + 1, INT64_MAX, (uint64_t)INT64_MAX + 1, UINT64_MAX,
+    };
+    uint64_t shape = next_random();
+    char* digits = out;
+    if(shape & 1) *digits++ = shape & 2 ? '-' : '+';
+    if(shape & 4) {
+        uint64_t limit = limits[(shape >> 3) % 5];
+        uint64_t delta = next_random() % 5;
+        if(!(shape & 64)) {
+            sprintf(digits, "%llu", (unsigned long long)(limit - delta));
+        } else if(limit + delta >= limit) {
+            sprintf(digits, "%llu", (unsigned long long)(limit + delta));
+        } else {
+            sprintf(digits, "%llu%c", (unsigned long long)(limit / 10), (char)('5' + delta));
+        }
+    } else {
+        int count = 1 + (int)(next_random() % 25);
+        for(int i = 0; i < count; ++i) digits[i] = '0' + next_random() % 10;
+        digits[count] = '\0';
+        if((shape & 24) == 24) digits[next_random() % count] = "a.:/ -+e"[shape >> 5 & 7];
+    }
+}
+
+static void test_integers(void) {
+    for(size_t i = 0; i < sizeof(integers) / sizeof(integers[0]); ++i) {
+        CHECK(check_integer(integers[i]));
+    }
+    
+    // Only [length] bytes are read.
+    int64_t value;
+    uint64_t unsigned_value;
+    CHECK(parsec_str_int64("-12345678901234567890", 3, &value) == PARSEC_SUCCESS && value == -12);
+    CHECK(parsec_str_uint64("123456789x", 9, &unsigned_value) == PARSEC_SUCCESS
+          && unsigned_value == 123456789);
+    CHECK(parsec_str_int("99999999999", 4) == 9999);
+    
+    int failures = 0;
+    char text[64];
+    for(int i = 0; i < TEST_INTEGERS && failures < 10; ++i) {
+        random_integer(text);
+        if(!check_integer(text)) failures += 1;
+    }
+    CHECK(failures == 0);
+}
+
+int main(void) {
+    test_doubles();
+    test_integers();
+    TEST_END();
+}
@@ -0,0 +1,125 @@
+//===--------------------------------------------------------------------------------------------===
+// estimate_test.c - parsec_estimate_tokens against the number of tokens parsec_lex finds
+// This source is part of ParseC
+//
+// Copyright (c) 2018 Amy Parent <amy@amyparent.com>
+// Licensed under the MIT License
+// =^•.•^=
+//===--------------------------------------------------------------------------------------------===
+#include "test.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <parsec/parsec.h>
+
+// Inputs up to 64KB are lexed whole, and bigger ones from a 64KB sample.
+#define SAMPLE_SIZE     (64 * 1024)
+#define TEST_INPUTS     24
+
+static uint64_t seed = 0x6a09e667f3bcc908ull;
+
+static uint64_t next_random(void) {
+    seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+    return seed >> 33;
+}
+
+static const char* const lines[] = {
+    "KEY 1 2.5 'str'\n", "# a comment, with no tokens in it\n", "\n", "a b c d e f g h i j\n",
+    "  long_identifier_with_a_single_token_on_its_line\n", "@ @ @ 1 2 3\r\n",
+    "n\xc3\xa4me 'a string with a few words in it' -1e10\n",
+};
+
+#define LINE_COUNT  (sizeof(lines) / sizeof(lines[0]))
+
+// Random lines from the pool above, so every part of the input has the same token density.
+static uint64_t make_text(char* text, uint64_t size) {
+    uint64_t length = 0;
+    for(;;) {
+        const char* line = lines[next_random() % LINE_COUNT];
+        uint64_t line_length = strlen(line);
+        if(length + line_length > size) return length;
+        memcpy(text + length, line, line_length);
+        length += line_length;
+    }
+}
+
+static uint64_t count_tokens(const parsec* parser) {
+    parsec copy = *parser;
+    uint64_t capacity = (copy.end - copy.head) + 1;
+    parsec_token* tokens = malloc(capacity * sizeof(parsec_token));
+    parsec_result result = parsec_lex(&copy, tokens, capacity);
+    CHECK(result >= 0);
+    free(tokens);
+    return copy.next_token;
+}
+
+// Inputs that fit in the sample are counted exactly, from the parser's head.
+static void test_exact(void) {
+    char* text = malloc(SAMPLE_SIZE);
+    uint64_t length = make_text(text, SAMPLE_SIZE);
+    parsec parser;
+    parsec_init(&parser, text, length, '#');
+    CHECK(parsec_estimate_tokens(&parser) == count_tokens(&parser));
+    parser.head = strchr(text + length / 2, '\n') + 1;
+    CHECK(parsec_estimate_tokens(&parser) == count_tokens(&parser));
+    parser.head = parser.end;
+    CHECK(parsec_estimate_tokens(&parser) == 0);
+    
+    parsec_init(&parser, "", 0, '#');
+    CHECK(parsec_estimate_tokens(&parser) == 0);
+    parsec_init(&parser, "A B C", 5, '#');
+    CHECK(parsec_estimate_tokens(&parser) == 3);
+    
+    // The estimate doesn't change the parser.
+    parsec_estimate_tokens(&parser);
+    CHECK(parser.head == parser.data && parser.end == parser.data + 5 && parser.next_token == 0);
+    free(text);
+}
+
+// Bigger inputs of random sizes, with their head anywhere in the first half: the estimate leaves
+// some headroom, but not much.
+static void test_random(void) {
+    char* text = malloc(2 * 1024 * 1024);
+    for(int i = 0; i < TEST_INPUTS; ++i) {
+        uint64_t size = SAMPLE_SIZE * 2 + next_random() % (2 * 1024 * 1024 - SAMPLE_SIZE * 2);
+        uint64_t length = make_text(text, size);
+        parsec parser;
+        parsec_init(&parser, text, length, '#');
+        if(i % 2) parser.head = strchr(text + next_random() % (length / 2), '\n') + 1;
+        
+        double ratio = (double)parsec_estimate_tokens(&parser) / count_tokens(&parser);
+        if(ratio < 1.0 || ratio > 1.3) fprintf(stderr, "%llu bytes: %.3f\n",
+                                               (unsigned long long)length, ratio);
+        CHECK(ratio >= 1.0 && ratio <= 1.3);
+    }
+    free(text);
+}
+
+// Only the sample is read: the rest of the input can't even be read here.
+static void test_sample_only(void) {
+    uint64_t page = (uint64_t)sysconf(_SC_PAGESIZE);
+    uint64_t readable = (SAMPLE_SIZE * 2 + page - 1) / page * page;
+    uint64_t size = readable * 8;
+    char* data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    CHECK(data != MAP_FAILED);
+    if(data == MAP_FAILED) return;
+    
+    make_text(data, readable);
+    CHECK(mprotect(data + readable, size - readable, PROT_NONE) == 0);
+    parsec parser;
+    parsec_init(&parser, data, readable, '#');
+    uint64_t sample = parsec_estimate_tokens(&parser);
+    parser.end = data + size;
+    CHECK(parsec_estimate_tokens(&parser) > sample * 4);
+    munmap(data, size);
+}
+
+int main(void) {
+    test_exact();
+    test_random();
+    test_sample_only();
+    TEST_END();
+}
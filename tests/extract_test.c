@@ -0,0 +1,72 @@
+//===--------------------------------------------------------------------------------------------===
+// extract_test.c - Extracting records into columns, and the rows that don't fit their schema
+// This source is part of ParseC
+//
+// Copyright (c) 2018 Amy Parent <amy@amyparent.com>
+// Licensed under the MIT License
+// =^•.•^=
+//===--------------------------------------------------------------------------------------------===
+#include "test.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <parsec/parsec.h>
+
+static const char source[] =
+    "POINT 1 2.5\n"
+    "# a comment, and a record nobody asked for\n"
+    "OTHER 1 2 3\n"
+    "POINT 9223372036854775807 -9223372036854775808\n"
+    "POINT 9223372036854775808 -9223372036854775809\n"
+    "POINT -9223372036854775809 100000000000000000000000\n"
+    "POINT 3 'not a number'\n"
+    "POINT 4 5 6\n"
+    "POINT 7 8 # trailing comment\n";
+
+static bool row_error(const parsec_schema* schema, uint64_t row) {
+    return schema->errors[row >> 3] & (1 << (row & 7));
+}
+
+int main(void) {
+    int64_t ints[8];
+    double reals[8];
+    uint8_t errors[1] = { 0 };
+    parsec_column columns[] = {
+        { PARSEC_FIELD_INT, ints },
+        { PARSEC_FIELD_FLOAT, reals },
+    };
+    parsec_schema schema = { "POINT", columns, 2, 8, 0, errors };
+    
+    parsec parser;
+    parsec_init(&parser, source, strlen(source), '#');
+    CHECK(parsec_extract(&parser, &schema, 1) == 7);
+    CHECK(schema.rows == 7);
+    
+    CHECK(!row_error(&schema, 0));
+    CHECK(ints[0] == 1 && reals[0] == 2.5);
+    
+    // The limits themselves fit, in both kinds of columns.
+    CHECK(!row_error(&schema, 1));
+    CHECK(ints[1] == INT64_MAX && reals[1] == (double)INT64_MIN);
+    
+    // One past the limits doesn't fit in an INT column.
+    CHECK(row_error(&schema, 2));
+    CHECK(row_error(&schema, 3));
+    
+    // Records that aren't numbers, or have too many fields. Comments can still end a record.
+    CHECK(row_error(&schema, 4));
+    CHECK(row_error(&schema, 5));
+    CHECK(!row_error(&schema, 6));
+    CHECK(ints[6] == 7 && reals[6] == 8.0);
+    
+    // It does in a FLOAT column, where integers that overflow are converted from their text.
+    parsec_column floats[] = { { PARSEC_FIELD_FLOAT, reals } };
+    parsec_schema wide = { "POINT", floats, 1, 8, 0, errors };
+    const char* big = "POINT 9223372036854775808\nPOINT -100000000000000000000000\n";
+    parsec_init(&parser, big, strlen(big), '#');
+    CHECK(parsec_extract(&parser, &wide, 1) == 2);
+    CHECK(!row_error(&wide, 0) && !row_error(&wide, 1));
+    CHECK(reals[0] == 9223372036854775808.0);
+    CHECK(reals[1] == -1e23);
+    TEST_END();
+}
@@ -0,0 +1,106 @@
+//===--------------------------------------------------------------------------------------------===
+// index_test.c - Building, saving and loading line indices, and lexing through them
+// This source is part of ParseC
+//
+// Copyright (c) 2018 Amy Parent <amy@amyparent.com>
+// Licensed under the MIT License
+// =^•.•^=
+//===--------------------------------------------------------------------------------------------===
+#include "test.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <parsec/parsec.h>
+
+#define TEST_LINES  20000
+
+static char* make_text(uint64_t* length) {
+    char* text = malloc(TEST_LINES * 32);
+    uint64_t size = 0;
+    for(int i = 0; i < TEST_LINES; ++i) size += sprintf(text + size, "line %d %d.5\n", i, i * 3);
+    *length = size;
+    return text;
+}
+
+static parsec_result load(const char* path, const char* text, uint64_t length) {
+    parsec parser;
+    parsec_line_index index;
+    parsec_init(&parser, text, length, '#');
+    parsec_result result = parsec_index_load(&index, path, &parser);
+    if(result == PARSEC_SUCCESS) parsec_index_deinit(&index);
+    return result;
+}
+
+static void test_round_trip(const char* text, uint64_t length) {
+    parsec parser;
+    parsec_line_index built, loaded;
+    parsec_init(&parser, text, length, '#');
+    CHECK(parsec_index_build(&parser, &built) == PARSEC_SUCCESS);
+    CHECK(built.count == TEST_LINES + 1);
+    CHECK(parsec_index_save(&built, "index_test.idx") == PARSEC_SUCCESS);
+    CHECK(parsec_index_load(&loaded, "index_test.idx", &parser) == PARSEC_SUCCESS);
+    CHECK(loaded.count == built.count);
+    CHECK(!memcmp(loaded.lines, built.lines, built.count * sizeof(uint64_t)));
+    
+    // Lines lexed on their own are the same tokens as the ones lexed in one go.
+    parsec_token* all = malloc((4 * TEST_LINES + 1) * sizeof(parsec_token));
+    parsec_token some[64];
+    parsec_init(&parser, text, length, '#');
+    CHECK(parsec_lex(&parser, all, 4 * TEST_LINES + 1) == 4 * TEST_LINES);
+    CHECK(parsec_lex_lines(&parser, &loaded, 1234, 3, some, 64) == 12);
+    for(int i = 0; i < 12; ++i) CHECK(some[i].start == all[1234 * 4 + i].start);
+    
+    uint64_t line, column;
+    parsec_token_location(&parser, &loaded, all[1234 * 4 + 2].start, &line, &column);
+    CHECK(line == 1234);
+    CHECK(column == 10);
+    free(all);
+    parsec_index_deinit(&built);
+    parsec_index_deinit(&loaded);
+}
+
+// Sources that aren't the one the index was built from, and indices that were tampered with.
+static void test_rejected(const char* text, uint64_t length) {
+    char* copy = malloc(length);
+    memcpy(copy, text, length);
+    CHECK(load("index_test.idx", copy, length) == PARSEC_SUCCESS);
+    CHECK(load("index_test.idx", copy, length - 1) == PARSEC_INVALID);
+    
+    // Same length, but the line returns moved: "line 10 30.5\n" becomes "line 1030.5 \n".
+    char* line = strstr(copy, "line 10 30.5\n");
+    memcpy(line, "line 1030.5 \n", 13);
+    CHECK(load("index_test.idx", copy, length) == PARSEC_INVALID);
+    
+    // A byte changed in the first sampled block, with the line returns left alone.
+    memcpy(copy, text, length);
+    copy[0] = 'X';
+    CHECK(load("index_test.idx", copy, length) == PARSEC_INVALID);
+    free(copy);
+    
+    parsec parser;
+    parsec_line_index index;
+    parsec_init(&parser, text, length, '#');
+    parsec_index_build(&parser, &index);
+    index.lines[100] += 1;
+    parsec_index_save(&index, "index_test_bad.idx");
+    CHECK(load("index_test_bad.idx", text, length) == PARSEC_INVALID);
+    index.lines[100] = index.lines[99];
+    parsec_index_save(&index, "index_test_bad.idx");
+    CHECK(load("index_test_bad.idx", text, length) == PARSEC_INVALID);
+    index.lines[100] = length + 1;
+    parsec_index_save(&index, "index_test_bad.idx");
+    CHECK(load("index_test_bad.idx", text, length) == PARSEC_INVALID);
+    parsec_index_deinit(&index);
+    
+    CHECK(load("index_test_missing.idx", text, length) == PARSEC_NOFILE);
+}
+
+int main(void) {
+    uint64_t length;
+    char* text = make_text(&length);
+    test_round_trip(text, length);
+    test_rejected(text, length);
+    free(text);
+    TEST_END();
+}
@@ -0,0 +1,113 @@
+//===--------------------------------------------------------------------------------------------===
+// keywords_test.c - Keyword tables, and the keyword indices the lexer stamps on KEY tokens
+// This source is part of ParseC
+//
+// Copyright (c) 2018 Amy Parent <amy@amyparent.com>
+// Licensed under the MIT License
+// =^•.•^=
+//===--------------------------------------------------------------------------------------------===
+#include "test.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <parsec/parsec.h>
+
+static const char* const words[] = {
+    "POINT", "POINTS", "P", "LINE", "line", "CIRCLE", "n\xc3\xa4me", "_private", "A1", "B2",
+};
+
+#define WORD_COUNT  (sizeof(words) / sizeof(words[0]))
+
+static int32_t find(const parsec_keywords* keywords, const char* word) {
+    return parsec_keywords_find(keywords, word, strlen(word));
+}
+
+static void test_find(void) {
+    parsec_keywords keywords;
+    CHECK(parsec_keywords_init(&keywords, words, WORD_COUNT) == PARSEC_SUCCESS);
+    for(uint32_t i = 0; i < WORD_COUNT; ++i) CHECK(find(&keywords, words[i]) == (int32_t)i);
+    
+    // Prefixes, extensions, other cases and other lengths of the same bytes are all unknown.
+    const char* unknown[] = {
+        "", "POIN", "POINTSS", "Line", "LINES", "CIRCL", "n\xc3\xa4", "A", "C",
+    };
+    for(size_t i = 0; i < sizeof(unknown) / sizeof(unknown[0]); ++i) {
+        CHECK(find(&keywords, unknown[i]) == PARSEC_KEYWORD_UNKNOWN);
+    }
+    CHECK(parsec_keywords_find(&keywords, "POINTS", 5) == 0);
+    parsec_keywords_deinit(&keywords);
+    
+    // Tables with no keywords, or a single one.
+    CHECK(parsec_keywords_init(&keywords, words, 0) == PARSEC_SUCCESS);
+    CHECK(find(&keywords, "POINT") == PARSEC_KEYWORD_UNKNOWN);
+    parsec_keywords_deinit(&keywords);
+    CHECK(parsec_keywords_init(&keywords, words + 3, 1) == PARSEC_SUCCESS);
+    CHECK(find(&keywords, "LINE") == 0);
+    CHECK(find(&keywords, "POINT") == PARSEC_KEYWORD_UNKNOWN);
+    parsec_keywords_deinit(&keywords);
+}
+
+static void test_duplicates(void) {
+    const char* const duplicated[] = { "A", "B", "C", "B" };
+    parsec_keywords keywords;
+    CHECK(parsec_keywords_init(&keywords, duplicated, 4) == PARSEC_INVALID);
+    CHECK(parsec_keywords_init(&keywords, duplicated, 3) == PARSEC_SUCCESS);
+    parsec_keywords_deinit(&keywords);
+}
+
+// Enough keywords that a perfect hash takes a few seeds, or a bigger table, to find.
+static void test_many(void) {
+    enum { MANY = 500 };
+    char (*storage)[16] = malloc(MANY * sizeof(*storage));
+    const char** many = malloc(MANY * sizeof(const char*));
+    for(int i = 0; i < MANY; ++i) {
+        sprintf(storage[i], "KW_%d", i * 7);
+        many[i] = storage[i];
+    }
+    
+    parsec_keywords keywords;
+    CHECK(parsec_keywords_init(&keywords, many, MANY) == PARSEC_SUCCESS);
+    for(int i = 0; i < MANY * 7; ++i) {
+        char word[16];
+        sprintf(word, "KW_%d", i);
+        CHECK(find(&keywords, word) == (i % 7 ? PARSEC_KEYWORD_UNKNOWN : i / 7));
+    }
+    parsec_keywords_deinit(&keywords);
+    free(many);
+    free(storage);
+}
+
+// KEY tokens get the index of their keyword, and every other token is unknown.
+static void test_stamping(void) {
+    static const char source[] = "POINT 1 2\nLINES 'POINT' # POINT\nn\xc3\xa4me LINE @\n";
+    parsec_keywords keywords;
+    parsec_keywords_init(&keywords, words, WORD_COUNT);
+    
+    parsec parser;
+    parsec_token tokens[32];
+    parsec_init(&parser, source, strlen(source), '#');
+    parsec_set_keywords(&parser, &keywords);
+    parsec_result count = parsec_lex(&parser, tokens, 32);
+    CHECK(count == 12);
+    
+    const int32_t expected[] = { 0, -1, -1, -1, -1, -1, -1, -1, 6, 3, -1, -1 };
+    for(parsec_result i = 0; i < count && i < 12; ++i) {
+        CHECK(tokens[i].keyword == (expected[i] < 0 ? PARSEC_KEYWORD_UNKNOWN : expected[i]));
+    }
+    
+    // Without a table, nothing is a keyword.
+    parsec_init(&parser, source, strlen(source), '#');
+    parsec_set_keywords(&parser, NULL);
+    CHECK(parsec_lex(&parser, tokens, 32) == 12);
+    for(int i = 0; i < 12; ++i) CHECK(tokens[i].keyword == PARSEC_KEYWORD_UNKNOWN);
+    parsec_keywords_deinit(&keywords);
+}
+
+int main(void) {
+    test_find();
+    test_duplicates();
+    test_many();
+    test_stamping();
+    TEST_END();
+}
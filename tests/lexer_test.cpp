@@ -0,0 +1,75 @@
+//===--------------------------------------------------------------------------------------------===
+// lexer_test.cpp - The C++ front-end against parsec_lex, dialect by dialect
+// This source is part of ParseC
+//
+// Copyright (c) 2018 Amy Parent <amy@amyparent.com>
+// Licensed under the MIT License
+// =^•.•^=
+//===--------------------------------------------------------------------------------------------===
+#include "test.h"
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <parsec/parsec.hpp>
+
+// Covers every kind of token, numbers that only some dialects accept, and multibyte keys.
+static const char* const sources[] = {
+    "",
+    "KEY 1 -2 3.25 'str' @ # comment\n\nPOINT 4 5 6\n",
+    "exp 1e5 2E-3 4d2 5D+1 -0.5e10\n",
+    "ñame 'café' é1 # ünïcode\n",
+    "tab\tsep\r\n\vff\f 42\n",
+    "% not a comment here, but one in the percent dialect\n",
+    "valid 1 2\nbroken 1.e5\n",
+    "unterminated 'string\n",
+    "trailing 12",
+};
+
+struct percent_dialect : parsecpp::default_dialect {
+    static constexpr char comment = '%';
+};
+
+// Lexes [source] both ways and checks that the C++ lexer stops at the same place, with the same
+// tokens (pointing at the same bytes), and the same result.
+template <typename Dialect>
+static void compare(const char* source, char comment, parsec_dialect dialect) {
+    std::size_t length = std::strlen(source);
+    std::vector<parsec_token> expected(length + 1);
+    parsec parser;
+    parsec_init(&parser, source, length, comment);
+    parsec_set_dialect(&parser, dialect);
+    parsec_result result = parsec_lex(&parser, expected.data(), expected.size());
+    // An invalid token still takes a slot in the C lexer's array.
+    std::ptrdiff_t count = result < 0 ? (std::ptrdiff_t)parser.next_token - 1 : result;
+    
+    parsecpp::lexer<Dialect> lexer({source, length});
+    std::vector<parsecpp::token> tokens;
+    std::ptrdiff_t lexed = lexer.lex(tokens);
+    CHECK(lexed == (result < 0 ? (std::ptrdiff_t)result : count));
+    CHECK((std::ptrdiff_t)tokens.size() == count);
+    if(result < 0) CHECK(source + lexer.offset() == parser.head);
+    else CHECK(lexer.done());
+    
+    for(std::ptrdiff_t i = 0; i < count && i < (std::ptrdiff_t)tokens.size(); ++i) {
+        CHECK(tokens[i].kind == expected[i].kind);
+        CHECK(tokens[i].text.data() == expected[i].start);
+        CHECK(tokens[i].text.size() == expected[i].length);
+    }
+    
+    std::size_t iterated = 0;
+    for(const parsecpp::token& token : parsecpp::lexer<Dialect>({source, length})) {
+        CHECK(iterated < tokens.size() && token.text == tokens[iterated].text);
+        iterated += 1;
+    }
+    CHECK(iterated == tokens.size());
+}
+
+int main() {
+    for(const char* source : sources) {
+        compare<parsecpp::default_dialect>(source, '#', PARSEC_DIALECT_DEFAULT);
+        compare<parsecpp::c_dialect>(source, '#', PARSEC_DIALECT_C);
+        compare<percent_dialect>(source, '%', PARSEC_DIALECT_DEFAULT);
+    }
+    TEST_END();
+}
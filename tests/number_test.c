@@ -0,0 +1,124 @@
+//===--------------------------------------------------------------------------------------------===
+// number_test.c - The number DFA, dialect by dialect, through parsec_lex
+// This source is part of ParseC
+//
+// Copyright (c) 2018 Amy Parent <amy@amyparent.com>
+// Licensed under the MIT License
+// =^•.•^=
+//===--------------------------------------------------------------------------------------------===
+#include "test.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <parsec/parsec.h>
+
+// What the first token of [text] lexes to in each dialect, indexed by parsec_dialect. For invalid
+// numbers, [length] is where the lexer stopped instead.
+typedef struct {
+    const char*     text;
+    parsec_kind     kind[PARSEC_DIALECT_COUNT];
+    uint64_t        length[PARSEC_DIALECT_COUNT];
+} number_case;
+
+#define INT     PARSEC_TOKEN_INT
+#define FLOAT   PARSEC_TOKEN_FLOAT
+#define BAD     PARSEC_TOKEN_INVALID
+
+static const number_case cases[] = {
+    { "0",          { INT, INT },       { 1, 1 } },
+    { "-12",        { INT, INT },       { 3, 3 } },
+    { "+7",         { INT, INT },       { 2, 2 } },
+    { "1.5",        { FLOAT, FLOAT },   { 3, 3 } },
+    { "-.5",        { FLOAT, FLOAT },   { 3, 3 } },
+    { "1e5",        { FLOAT, FLOAT },   { 3, 3 } },
+    { "1E-3",       { FLOAT, FLOAT },   { 4, 4 } },
+    { "2.5e+10",    { FLOAT, FLOAT },   { 7, 7 } },
+    // 'd' and 'D' only start an exponent in the default dialect.
+    { "1d5",        { FLOAT, BAD },     { 3, 1 } },
+    { "4.5D-2",     { FLOAT, BAD },     { 6, 3 } },
+    { "1.",         { BAD, BAD },       { 2, 2 } },
+    { ".",          { BAD, BAD },       { 1, 1 } },
+    { ".e1",        { BAD, BAD },       { 1, 1 } },
+    { "-",          { BAD, BAD },       { 1, 1 } },
+    { "+-1",        { BAD, BAD },       { 1, 1 } },
+    { "1e",         { BAD, BAD },       { 2, 2 } },
+    { "1e+",        { BAD, BAD },       { 3, 3 } },
+    { "1e5.0",      { BAD, BAD },       { 3, 3 } },
+    { "1.2.3",      { BAD, BAD },       { 3, 3 } },
+    // Numbers end on whitespace or a line return, and nothing else.
+    { "12 x",       { INT, INT },       { 2, 2 } },
+    { "12\tx",      { INT, INT },       { 2, 2 } },
+    { "12\v\f\r\n", { INT, INT },       { 2, 2 } },
+    { "1.5\n",      { FLOAT, FLOAT },   { 3, 3 } },
+    { "12a",        { BAD, BAD },       { 2, 2 } },
+    { "12#",        { BAD, BAD },       { 2, 2 } },
+    { "12'x'",      { BAD, BAD },       { 2, 2 } },
+    { "12@",        { BAD, BAD },       { 2, 2 } },
+    { "12\xc3\xa9", { BAD, BAD },       { 2, 2 } },
+};
+
+// Lexes [text] and checks its first token, or where the lexer stopped if it's invalid.
+static bool check(const char* text, uint64_t length, parsec_dialect dialect,
+                  parsec_kind kind, uint64_t expected) {
+    parsec parser;
+    parsec_token tokens[8];
+    parsec_init(&parser, text, length, '#');
+    parsec_set_dialect(&parser, dialect);
+    parsec_result result = parsec_lex(&parser, tokens, 8);
+    
+    if(kind == BAD) return result == PARSEC_INVALID && parser.head == text + expected;
+    return result != PARSEC_INVALID && parser.next_token >= 1
+        && tokens[0].kind == kind && tokens[0].start == text && tokens[0].length == expected;
+}
+
+static void test_cases(void) {
+    for(size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); ++i) {
+        for(int d = 0; d < PARSEC_DIALECT_COUNT; ++d) {
+            bool ok = check(cases[i].text, strlen(cases[i].text), d,
+                            cases[i].kind[d], cases[i].length[d]);
+            if(!ok) fprintf(stderr, "'%s' in dialect %d\n", cases[i].text, d);
+            CHECK(ok);
+        }
+    }
+}
+
+// Digit runs are taken in one go, without going through the DFA for each of them: they must still
+// stop on the first byte that isn't a digit, and at the end of the input.
+static void test_digit_runs(void) {
+    enum { RUN = 4096 };
+    char* text = malloc(3 * RUN + 16);
+    
+    memset(text, '9', RUN);
+    for(int d = 0; d < PARSEC_DIALECT_COUNT; ++d) {
+        CHECK(check(text, RUN, d, INT, RUN));
+        CHECK(check(text, RUN - 1, d, INT, RUN - 1));
+    }
+    text[RUN] = 'x';
+    for(int d = 0; d < PARSEC_DIALECT_COUNT; ++d) CHECK(check(text, RUN + 1, d, BAD, RUN));
+    
+    // A long mantissa, and a long exponent, and then a trailing line return.
+    uint64_t length = 0;
+    text[length++] = '-';
+    memset(text + length, '1', RUN);
+    length += RUN;
+    text[length++] = '.';
+    memset(text + length, '2', RUN);
+    length += RUN;
+    text[length++] = 'e';
+    text[length++] = '-';
+    memset(text + length, '3', RUN);
+    length += RUN;
+    text[length] = '\n';
+    for(int d = 0; d < PARSEC_DIALECT_COUNT; ++d) CHECK(check(text, length + 1, d, FLOAT, length));
+    text[RUN + 1 + RUN + 1] = 'd';
+    CHECK(check(text, length + 1, PARSEC_DIALECT_DEFAULT, FLOAT, length));
+    CHECK(check(text, length + 1, PARSEC_DIALECT_C, BAD, RUN + 1 + RUN + 1));
+    free(text);
+}
+
+int main(void) {
+    test_cases();
+    test_digit_runs();
+    TEST_END();
+}
@@ -0,0 +1,109 @@
+//===--------------------------------------------------------------------------------------------===
+// parallel_test.c - parsec_lex_parallel against a sequential parsec_lex
+// This source is part of ParseC
+//
+// Copyright (c) 2018 Amy Parent <amy@amyparent.com>
+// Licensed under the MIT License
+// =^•.•^=
+//===--------------------------------------------------------------------------------------------===
+#include "test.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <parsec/parsec.h>
+
+// Big enough for 8 chunks of PARALLEL_MIN_CHUNK. Dense and sparse lines are laid out so that some
+// chunks outgrow the range of the caller's array they are lent, and others leave gaps behind.
+#define TEST_SIZE   (2560 * 1024)
+
+typedef enum { LAYOUT_DENSE_FIRST, LAYOUT_DENSE_LAST, LAYOUT_STRIPES } test_layout;
+
+static const char dense_line[] = "a b c d e f g h 1 2 3 'x'\n";
+static const char sparse_line[] = "# a long comment, and nothing else on the line, to make it sparse\n";
+
+// Generates an input, with [bad] (if not NULL) inserted at about [bad_at] of its size.
+static char* make_input(test_layout layout, const char* bad, double bad_at, uint64_t* length) {
+    char* text = malloc(TEST_SIZE + 256);
+    uint64_t size = 0;
+    uint64_t bad_offset = bad ? (uint64_t)(TEST_SIZE * bad_at) : UINT64_MAX;
+    for(int line = 0; size < TEST_SIZE; ++line) {
+        bool dense = layout == LAYOUT_DENSE_FIRST ? size < TEST_SIZE / 2
+                   : layout == LAYOUT_DENSE_LAST ? size >= TEST_SIZE / 2
+                   : (line / 500) % 2;
+        size += sprintf(text + size, "%s", dense ? dense_line : sparse_line);
+        if(bad && size >= bad_offset) {
+            size += sprintf(text + size, "%s", bad);
+            bad_offset = UINT64_MAX;
+        }
+    }
+    *length = size;
+    return text;
+}
+
+// Lexes [text] with each capacity both ways: the results, the parsers' state and every token that
+// was filled in must be the same. Capacities around the exact count are the ones that end up
+// cutting a chunk short.
+static void compare(const char* text, uint64_t length) {
+    parsec_token* expected = malloc((length + 1) * sizeof(parsec_token));
+    parsec_token* tokens = malloc((length + 1) * sizeof(parsec_token));
+    parsec parser;
+    parsec_init(&parser, text, length, '#');
+    parsec_lex(&parser, expected, length + 1);
+    uint64_t exact = parser.next_token;
+    uint64_t capacities[] = { length + 1, exact, exact - 1, exact - 2, exact / 2, 1, 0 };
+    
+    for(size_t i = 0; i < sizeof(capacities) / sizeof(capacities[0]); ++i) {
+        uint64_t capacity = capacities[i];
+        parsec sequential;
+        parsec_init(&sequential, text, length, '#');
+        parsec_result want = parsec_lex(&sequential, expected, capacity);
+        // An invalid token's slot is never filled in.
+        uint64_t filled = sequential.next_token - (want == PARSEC_INVALID ? 1 : 0);
+        
+        for(unsigned threads = 2; threads <= 8; threads *= 2) {
+            parsec parallel;
+            parsec_init(&parallel, text, length, '#');
+            parsec_result got = parsec_lex_parallel(&parallel, tokens, capacity, threads);
+            bool same = want == got && sequential.next_token == parallel.next_token
+                     && sequential.head == parallel.head;
+            for(uint64_t j = 0; same && j < filled; ++j) {
+                same = tokens[j].kind == expected[j].kind && tokens[j].start == expected[j].start
+                    && tokens[j].length == expected[j].length;
+            }
+            if(!same) {
+                fprintf(stderr, "capacity %llu, %u threads: result %d/%d, %llu/%llu tokens, "
+                        "head %lld/%lld\n", (unsigned long long)capacity, threads, want, got,
+                        (unsigned long long)sequential.next_token,
+                        (unsigned long long)parallel.next_token,
+                        (long long)(sequential.head - text), (long long)(parallel.head - text));
+            }
+            CHECK(same);
+        }
+    }
+    free(expected);
+    free(tokens);
+}
+
+int main(void) {
+    const test_layout layouts[] = { LAYOUT_DENSE_FIRST, LAYOUT_DENSE_LAST, LAYOUT_STRIPES };
+    for(int i = 0; i < 3; ++i) {
+        uint64_t length;
+        char* text = make_input(layouts[i], NULL, 0, &length);
+        compare(text, length);
+        free(text);
+    }
+    
+    // Invalid tokens, at the start, in the middle and at the end of the input.
+    const char* bad[] = { "\x01\n", "bad 1.e5\n", "'unterminated\n" };
+    const double at[] = { 0.01, 0.4, 0.99 };
+    for(int i = 0; i < 3; ++i) {
+        for(int j = 0; j < 3; ++j) {
+            uint64_t length;
+            char* text = make_input(layouts[j], bad[i], at[i], &length);
+            compare(text, length);
+            free(text);
+        }
+    }
+    TEST_END();
+}
@@ -0,0 +1,178 @@
+//===--------------------------------------------------------------------------------------------===
+// reader_test.c - Round trips through parsec_reader, for plain and compressed files
+// This source is part of ParseC
+//
+// Copyright (c) 2018 Amy Parent <amy@amyparent.com>
+// Licensed under the MIT License
+// =^•.•^=
+//===--------------------------------------------------------------------------------------------===
+#include "test.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <parsec/parsec.h>
+#ifdef PARSEC_WITH_ZLIB
+#include <zlib.h>
+#endif
+#ifdef PARSEC_WITH_ZSTD
+#include <zstd.h>
+#endif
+
+// Archives are generated from the same text every time, and written to the working directory.
+// Every file, however it's compressed, must lex to the tokens of the text itself.
+#define TEST_LINES  50000
+#define TEST_BATCH  1000
+
+static char* text;
+static uint64_t text_length;
+static parsec_token* expected;
+static uint64_t expected_count;
+
+static void make_text(void) {
+    text = malloc(TEST_LINES * 64);
+    text_length = 0;
+    for(int i = 0; i < TEST_LINES; ++i)
+        text_length += sprintf(text + text_length, "line%d %d %d.25 'str %d' @\n", i, i * 7, i, i);
+    
+    parsec parser;
+    parsec_init(&parser, text, text_length, '#');
+    expected = malloc((text_length + 1) * sizeof(parsec_token));
+    expected_count = (uint64_t)parsec_lex(&parser, expected, text_length + 1);
+}
+
+static void write_file(const char* path, const void* data, uint64_t length) {
+    FILE* file = fopen(path, "wb");
+    CHECK(file && fwrite(data, 1, length, file) == length);
+    if(file) fclose(file);
+}
+
+// Lexes [path] through a reader, checking every token against the plain text's. Returns the
+// first error, or PARSEC_SUCCESS once the file has been lexed, with the token count in [count].
+static parsec_result read_file(const char* path, uint64_t* count) {
+    parsec_reader* reader;
+    parsec_result result = parsec_reader_open(&reader, path, '#');
+    *count = 0;
+    if(result != PARSEC_SUCCESS) return result;
+    
+    parsec_token tokens[TEST_BATCH];
+    bool same = true;
+    while((result = parsec_reader_lex(reader, tokens, TEST_BATCH)) > 0) {
+        for(int i = 0; i < result && same; ++i) {
+            const parsec_token* want = &expected[*count + i];
+            same = *count + i < expected_count && tokens[i].kind == want->kind
+                && tokens[i].length == want->length
+                && !memcmp(tokens[i].start, want->start, want->length);
+        }
+        *count += result;
+    }
+    parsec_reader_close(reader);
+    CHECK(same);
+    return result;
+}
+
+static void check_complete(const char* path) {
+    uint64_t count;
+    parsec_result result = read_file(path, &count);
+    if(result != PARSEC_SUCCESS || count != expected_count) {
+        fprintf(stderr, "%s: result %d, %llu/%llu tokens\n", path, result,
+                (unsigned long long)count, (unsigned long long)expected_count);
+    }
+    CHECK(result == PARSEC_SUCCESS);
+    CHECK(count == expected_count);
+}
+
+#if defined(PARSEC_WITH_ZLIB) || defined(PARSEC_WITH_ZSTD)
+// Whatever was decoded before the cut is still lexed (and checked), but the file must not read as
+// complete. Without a trailer, that can be all of the tokens.
+static void check_truncated(const char* path) {
+    uint64_t count;
+    CHECK(read_file(path, &count) == PARSEC_NOFILE);
+    CHECK(count <= expected_count);
+}
+#endif
+
+// MARK: - Formats
+
+static void test_plain(void) {
+    write_file("reader_plain.txt", text, text_length);
+    check_complete("reader_plain.txt");
+}
+
+#ifdef PARSEC_WITH_ZLIB
+static void write_gzip(const char* path, const char* mode, const char* data, uint64_t length) {
+    gzFile archive = gzopen(path, mode);
+    CHECK(archive && gzwrite(archive, data, (unsigned)length) == (int)length);
+    if(archive) gzclose(archive);
+}
+
+static void test_gzip(void) {
+    write_gzip("reader_single.gz", "wb", text, text_length);
+    check_complete("reader_single.gz");
+    
+    // Members are split in the middle of a line, which the stream has to put back together.
+    uint64_t half = text_length / 2 + 3;
+    write_gzip("reader_multi.gz", "wb", text, half);
+    write_gzip("reader_multi.gz", "ab", text + half, text_length - half);
+    check_complete("reader_multi.gz");
+    
+    FILE* file = fopen("reader_single.gz", "rb");
+    CHECK(file);
+    if(!file) return;
+    char* archive = malloc(text_length);
+    uint64_t length = fread(archive, 1, text_length, file);
+    fclose(file);
+    write_file("reader_truncated.gz", archive, length / 2);
+    check_truncated("reader_truncated.gz");
+    // Without its trailer, a member can't be checked, so it can't be trusted either.
+    write_file("reader_notrailer.gz", archive, length - 4);
+    check_truncated("reader_notrailer.gz");
+    free(archive);
+}
+#endif
+
+#ifdef PARSEC_WITH_ZSTD
+static uint64_t compress_zstd(char* out, const char* data, uint64_t length) {
+    size_t size = ZSTD_compress(out, ZSTD_compressBound(length), data, length, 3);
+    CHECK(!ZSTD_isError(size));
+    return ZSTD_isError(size) ? 0 : size;
+}
+
+static void test_zstd(void) {
+    char* archive = malloc(2 * ZSTD_compressBound(text_length));
+    
+    uint64_t length = compress_zstd(archive, text, text_length);
+    write_file("reader_single.zst", archive, length);
+    check_complete("reader_single.zst");
+    
+    write_file("reader_truncated.zst", archive, length / 2);
+    check_truncated("reader_truncated.zst");
+    write_file("reader_notail.zst", archive, length - 1);
+    check_truncated("reader_notail.zst");
+    
+    uint64_t half = text_length / 2 + 3;
+    uint64_t first = compress_zstd(archive, text, half);
+    uint64_t second = compress_zstd(archive + first, text + half, text_length - half);
+    write_file("reader_multi.zst", archive, first + second);
+    check_complete("reader_multi.zst");
+    
+    free(archive);
+}
+#endif
+
+// Each format is its own test, which is only registered when the library was built to read it.
+int main(int argc, const char** argv) {
+    const char* format = argc > 1 ? argv[1] : "plain";
+    make_text();
+    if(!strcmp(format, "plain")) test_plain();
+#ifdef PARSEC_WITH_ZLIB
+    else if(!strcmp(format, "gzip")) test_gzip();
+#endif
+#ifdef PARSEC_WITH_ZSTD
+    else if(!strcmp(format, "zstd")) test_zstd();
+#endif
+    else CHECK(!"unknown format");
+    free(expected);
+    free(text);
+    TEST_END();
+}
@@ -0,0 +1,200 @@
+//===--------------------------------------------------------------------------------------------===
+// relex_test.c - parsec_relex against lexing the edited source from scratch
+// This source is part of ParseC
+//
+// Copyright (c) 2018 Amy Parent <amy@amyparent.com>
+// Licensed under the MIT License
+// =^•.•^=
+//===--------------------------------------------------------------------------------------------===
+#include "test.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <parsec/parsec.h>
+
+#define TEST_SIZE       (64 * 1024)
+#define TEST_CAPACITY   (TEST_SIZE + 1)
+
+// The source being edited, and its tokens as parsec_relex keeps them up to date. Edits are applied
+// either in place or to a second buffer, and the two buffers are swapped after each one.
+typedef struct {
+    parsec          parser;
+    char*           source;
+    char*           spare;
+    uint64_t        length;
+    parsec_token*   tokens;
+    uint64_t        count;
+} test_state;
+
+static parsec_token* expected;
+
+static void state_init(test_state* state, const char* text) {
+    state->source = malloc(TEST_SIZE);
+    state->spare = malloc(TEST_SIZE);
+    state->tokens = malloc(TEST_CAPACITY * sizeof(parsec_token));
+    state->length = strlen(text);
+    memcpy(state->source, text, state->length);
+    parsec_init(&state->parser, state->source, state->length, '#');
+    parsec_result result = parsec_lex(&state->parser, state->tokens, TEST_CAPACITY);
+    CHECK(result >= 0);
+    state->count = result;
+}
+
+static void state_deinit(test_state* state) {
+    free(state->source);
+    free(state->spare);
+    free(state->tokens);
+}
+
+// Applies [edit] to the source, inserting [text], and checks that parsec_relex ends up with the
+// tokens parsec_lex finds in the result. Edits that make the source invalid must leave the tokens
+// alone: they are then undone. Returns whether the edit was kept.
+static bool check_edit(test_state* state, parsec_edit edit, const char* text, bool in_place) {
+    char* out = in_place ? state->source : state->spare;
+    uint64_t tail = state->length - edit.offset - edit.removed;
+    char* undo = malloc(state->length + 1);
+    memcpy(undo, state->source, state->length);
+    memmove(out + edit.offset + edit.inserted, state->source + edit.offset + edit.removed, tail);
+    memmove(out, state->source, edit.offset);
+    memcpy(out + edit.offset, text, edit.inserted);
+    uint64_t length = state->length - edit.removed + edit.inserted;
+    
+    parsec reference;
+    parsec_init(&reference, out, length, '#');
+    parsec_result want = parsec_lex(&reference, expected, TEST_CAPACITY);
+    
+    parsec_token* saved = malloc((state->count + 1) * sizeof(parsec_token));
+    memcpy(saved, state->tokens, state->count * sizeof(parsec_token));
+    parsec_result got = parsec_relex(&state->parser, out, edit, state->tokens, state->count,
+                                     TEST_CAPACITY);
+    
+    bool same = (want < 0) == (got < 0);
+    same = same && state->parser.data == out && state->parser.end == out + length;
+    if(want >= 0 && got >= 0) {
+        same = same && want == got && state->parser.head == state->parser.end;
+        // Once invalid UTF-8 was seen, the parser stays on the safe side, but it must never claim
+        // an invalid source is valid.
+        same = same && (reference.validated || !state->parser.validated);
+        for(parsec_result i = 0; same && i < got; ++i) {
+            const parsec_token* token = &state->tokens[i];
+            same = token->kind == expected[i].kind && token->start == expected[i].start
+                && token->length == expected[i].length;
+        }
+    } else {
+        same = same && !memcmp(saved, state->tokens, state->count * sizeof(parsec_token));
+    }
+    if(!same) {
+        fprintf(stderr, "edit at %llu, -%llu +%llu '%.*s' (%s): %d/%d\n",
+                (unsigned long long)edit.offset, (unsigned long long)edit.removed,
+                (unsigned long long)edit.inserted, (int)edit.inserted, text,
+                in_place ? "in place" : "moved", want, got);
+    }
+    CHECK(same);
+    
+    bool kept = want >= 0 && got >= 0;
+    if(kept) {
+        state->length = length;
+        state->count = got;
+        if(!in_place) {
+            state->spare = state->source;
+            state->source = out;
+        }
+    } else {
+        memcpy(state->source, undo, state->length);
+        parsec_init(&state->parser, state->source, state->length, '#');
+        memcpy(state->tokens, saved, state->count * sizeof(parsec_token));
+    }
+    free(saved);
+    free(undo);
+    return kept;
+}
+
+static void edit(test_state* state, uint64_t offset, uint64_t removed, const char* text) {
+    parsec_edit e = { offset, removed, strlen(text) };
+    CHECK(check_edit(state, e, text, false));
+}
+
+static const char base[] = "KEY 1 2.5\nPT 3 'x' # hi\n@ abc\n\nLN 4 5\n";
+
+// Edits on the first and last lines, and edits that join or split lines.
+static void test_lines(void) {
+    test_state state;
+    state_init(&state, base);
+    edit(&state, 0, 0, "NEW 1\n");                              // a line before the first one
+    edit(&state, 0, 3, "OLD");                                  // the first token
+    edit(&state, state.length, 0, "TAIL 9");                    // a last line with no line return
+    edit(&state, state.length - 1, 1, "10");                    // the very last byte
+    edit(&state, state.length, 0, "\n");                        // ...which then gets one
+    
+    const char* line = strchr(state.source, '\n');
+    edit(&state, line - state.source, 1, " ");                  // joins the first two lines
+    edit(&state, 1, 0, "\n");                                   // splits the first token
+    edit(&state, 2, 0, "\n\n\n");                               // adds empty lines
+    line = strstr(state.source, "\n\n");
+    edit(&state, line - state.source, 2, "");                   // removes a line return and a line
+    edit(&state, 0, state.length, "");                          // everything
+    edit(&state, 0, 0, base);                                   // ...and back
+    state_deinit(&state);
+    
+    // Invalid edits, which leave the tokens as they were.
+    state_init(&state, base);
+    parsec_edit bad = { 4, 1, 4 };
+    CHECK(!check_edit(&state, bad, "1.e5", false));
+    CHECK(!check_edit(&state, bad, "'str", true));
+    state_deinit(&state);
+}
+
+// An edit that needs more tokens than there's room for fails, and leaves the tokens alone.
+static void test_capacity(void) {
+    test_state state;
+    state_init(&state, base);
+    parsec_token* saved = malloc(state.count * sizeof(parsec_token));
+    memcpy(saved, state.tokens, state.count * sizeof(parsec_token));
+    const char* text = "A B C D\n";
+    memmove(state.source + 8, state.source, state.length);
+    memcpy(state.source, text, 8);
+    parsec_edit grow = { 0, 0, 8 };
+    parsec_result result = parsec_relex(&state.parser, state.source, grow, state.tokens,
+                                        state.count, state.count + 1);
+    CHECK(result == PARSEC_NOMEM);
+    CHECK(!memcmp(saved, state.tokens, state.count * sizeof(parsec_token)));
+    free(saved);
+    state_deinit(&state);
+}
+
+// Random edits, in place or not, of random pieces of text, some of which don't lex.
+static void test_random(void) {
+    static const char* const pieces[] = {
+        "KEY ", "12", " 3.5\n", "\n", "'str'", "# c\n", "x", " ", "@", "\xc3\xa9", "\n\n",
+        "'", "1.",
+    };
+    uint64_t seed = 0x853c49e6748fea9bull;
+    test_state state;
+    state_init(&state, base);
+    int kept = 0;
+    
+    for(int round = 0; round < 5000; ++round) {
+        seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+        uint64_t pick = seed >> 24;
+        uint64_t offset = pick % (state.length + 1);
+        uint64_t removed = (pick >> 20) % 5;
+        if(removed > state.length - offset) removed = state.length - offset;
+        const char* text = pieces[(pick >> 24) % (sizeof(pieces) / sizeof(pieces[0]))];
+        if(state.length + strlen(text) >= TEST_SIZE / 2) text = "";
+        parsec_edit e = { offset, removed, strlen(text) };
+        kept += check_edit(&state, e, text, (pick >> 30) & 1);
+    }
+    // Most edits should go through, or the source stays too small to be interesting.
+    CHECK(kept > 2500);
+    state_deinit(&state);
+}
+
+int main(void) {
+    expected = malloc(TEST_CAPACITY * sizeof(parsec_token));
+    test_lines();
+    test_capacity();
+    test_random();
+    free(expected);
+    TEST_END();
+}
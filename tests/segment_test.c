@@ -0,0 +1,177 @@
+//===--------------------------------------------------------------------------------------------===
+// segment_test.c - Segmented lexing against parsec_lex, including inputs bigger than 4GB
+// This source is part of ParseC
+//
+// Copyright (c) 2018 Amy Parent <amy@amyparent.com>
+// Licensed under the MIT License
+// =^•.•^=
+//===--------------------------------------------------------------------------------------------===
+#include "test.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <parsec/parsec.h>
+
+#define TEXT_SIZE       (256 * 1024)
+
+static uint64_t make_text(char* text, uint64_t size) {
+    uint64_t written = 0;
+    for(int line = 0; written + 64 < size; ++line) {
+        const char* format = line % 5 ? "KEY_%d %d -%d.5 'str' @\n" : "# comment %d\n\n";
+        written += sprintf(text + written, format, line, line, line);
+    }
+    return written;
+}
+
+// The tokens parsec_lex finds from [parser]'s head, which is left where lexing stopped.
+static parsec_token* lex_all(parsec* parser, parsec_result* result, uint64_t* count) {
+    uint64_t capacity = (parser->end - parser->head) + 1;
+    parsec_token* tokens = malloc(capacity * sizeof(parsec_token));
+    *result = parsec_lex(parser, tokens, capacity);
+    *count = parser->next_token - (*result == PARSEC_INVALID ? 1 : 0);
+    return tokens;
+}
+
+// Checks [segments] cover [parser]'s input from [head] with whole lines of at most [size] bytes,
+// and hold [expected] in order, up to and including the segment that failed, if any.
+static bool same_as_lexed(const parsec* parser, const parsec_segments* segments, const char* head,
+                          uint64_t size, const parsec_token* expected, uint64_t count) {
+    uint64_t next = head - parser->data;
+    uint64_t seen = 0;
+    bool failed = false;
+    for(uint64_t i = 0; i < segments->count; ++i) {
+        const parsec_segment* segment = &segments->segments[i];
+        if(segment->base != next || segment->length > size || !segment->length) return false;
+        if(i && parser->data[segment->base - 1] != '\n') return false;
+        next += segment->length;
+        if(failed) continue;
+        
+        for(uint64_t j = 0; j < segment->count; ++j, ++seen) {
+            parsec_packed_token token = segment->tokens[j];
+            const char* start = parsec_segment_start(parser, segment, token);
+            if(seen == count || parsec_packed_kind(token) != expected[seen].kind
+               || parsec_packed_length(token) != expected[seen].length
+               || start != expected[seen].start) return false;
+        }
+        failed = segment->result != PARSEC_SUCCESS;
+    }
+    return next == (uint64_t)(parser->end - parser->data) && seen == count;
+}
+
+static void check_segments(char* text, uint64_t length, uint64_t skip) {
+    const uint64_t sizes[] = { 64, 1000, 4096, 0 };
+    for(size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s) {
+        parsec reference;
+        parsec_init(&reference, text, length, '#');
+        reference.head += skip;
+        parsec_result want;
+        uint64_t count;
+        parsec_token* expected = lex_all(&reference, &want, &count);
+        
+        parsec parser;
+        parsec_init(&parser, text, length, '#');
+        parser.head += skip;
+        const char* head = parser.head;
+        parsec_segments segments;
+        CHECK(parsec_segments_init(&segments, &parser, sizes[s]) == PARSEC_SUCCESS);
+        parsec_result got = parsec_lex_segments(&parser, &segments);
+        CHECK(got == (want < 0 ? want : PARSEC_SUCCESS));
+        CHECK(parser.head == reference.head);
+        uint64_t size = sizes[s] ? sizes[s] : PARSEC_SEGMENT_MAX;
+        CHECK(same_as_lexed(&parser, &segments, head, size, expected, count));
+        
+        // Segments lexed on their own, in any order, come up with the same tokens.
+        if(want >= 0) {
+            for(uint64_t i = segments.count; i-- > 0;) {
+                CHECK(parsec_lex_segment(&parser, &segments, i) == PARSEC_SUCCESS);
+            }
+            CHECK(same_as_lexed(&parser, &segments, head, size, expected, count));
+        }
+        parsec_segments_deinit(&segments);
+        CHECK(segments.segments == NULL && segments.count == 0);
+        free(expected);
+    }
+}
+
+static void test_small(void) {
+    char* text = malloc(TEXT_SIZE);
+    uint64_t length = make_text(text, TEXT_SIZE);
+    check_segments(text, length, 0);
+    check_segments(text, length, strchr(text, '\n') + 1 - text);
+    check_segments(text, length - 3, 0);
+    check_segments("", 0, 0);
+    
+    // An invalid token stops lexing in its segment, and the segments after it are left alone.
+    memcpy(strstr(text + length / 2, "KEY_"), "1.e5", 4);
+    check_segments(text, length, 0);
+    
+    // A line that doesn't fit in a segment.
+    parsec parser;
+    parsec_segments segments;
+    parsec_init(&parser, text, length, '#');
+    CHECK(parsec_segments_init(&segments, &parser, 8) == PARSEC_OVERFLOW);
+    CHECK(segments.segments == NULL && segments.count == 0);
+    free(text);
+}
+
+// parsec_init would validate the whole input: only the text after [offset] is, and the zeros before
+// it are valid UTF-8 anyway.
+static void init_huge(parsec* parser, char* data, uint64_t offset, uint64_t length) {
+    parsec_init(parser, data + offset, length - offset, '#');
+    parser->data = data;
+}
+
+// A mapping a little over 4GB, of which only the pages around the text are ever touched: tokens
+// past the first 4GB still resolve to the right place.
+static void test_huge(void) {
+    const uint64_t offset = PARSEC_SEGMENT_MAX + 4096;
+    const uint64_t size = offset + TEXT_SIZE;
+    char* data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS
+                      | MAP_NORESERVE, -1, 0);
+    if(data == MAP_FAILED) {
+        fprintf(stderr, "can't map %llu bytes, skipping\n", (unsigned long long)size);
+        return;
+    }
+    data[PARSEC_SEGMENT_MAX - 1] = '\n';
+    uint64_t length = offset + make_text(data + offset, TEXT_SIZE);
+    
+    // The default split puts the cut right after the line return that ends the first 4GB.
+    parsec parser;
+    parsec_segments segments;
+    init_huge(&parser, data, offset, length);
+    parser.head = data;
+    CHECK(parsec_segments_init(&segments, &parser, 0) == PARSEC_SUCCESS);
+    CHECK(segments.count == 2);
+    CHECK(segments.segments[0].length == PARSEC_SEGMENT_MAX);
+    CHECK(segments.segments[1].base == PARSEC_SEGMENT_MAX);
+    parsec_segments_deinit(&segments);
+    
+    // Lexing the text only, in one segment or in many.
+    parsec reference;
+    init_huge(&reference, data, offset, length);
+    parsec_result want;
+    uint64_t count;
+    parsec_token* expected = lex_all(&reference, &want, &count);
+    CHECK(want >= 0);
+    
+    const uint64_t sizes[] = { 0, 4096 };
+    for(size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s) {
+        init_huge(&parser, data, offset, length);
+        CHECK(parsec_segments_init(&segments, &parser, sizes[s]) == PARSEC_SUCCESS);
+        CHECK(parsec_lex_segments(&parser, &segments) == PARSEC_SUCCESS);
+        CHECK(parser.head == parser.end);
+        uint64_t segment_size = sizes[s] ? sizes[s] : PARSEC_SEGMENT_MAX;
+        CHECK(same_as_lexed(&parser, &segments, data + offset, segment_size, expected, count));
+        parsec_segments_deinit(&segments);
+    }
+    free(expected);
+    munmap(data, size);
+}
+
+int main(void) {
+    test_small();
+    test_huge();
+    TEST_END();
+}
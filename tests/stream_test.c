@@ -0,0 +1,179 @@
+//===--------------------------------------------------------------------------------------------===
+// stream_test.c - parsec_feed/parsec_finish against parsec_lex on the whole input
+// This source is part of ParseC
+//
+// Copyright (c) 2018 Amy Parent <amy@amyparent.com>
+// Licensed under the MIT License
+// =^•.•^=
+//===--------------------------------------------------------------------------------------------===
+#include "test.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <parsec/parsec.h>
+
+// Streamed tokens point into the stream's buffer, which moves: they're compared by their offset
+// in the whole input, which is what was fed so far minus what the buffer still holds.
+typedef struct {
+    parsec_kind kind;
+    uint64_t    offset;
+    uint64_t    length;
+} test_token;
+
+typedef struct {
+    test_token* tokens;
+    uint64_t    count;
+    uint64_t    head;
+    int         result;
+} test_run;
+
+static uint64_t seed = 0x2545f4914f6cdd1dull;
+
+static uint64_t next_random(void) {
+    seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+    return seed >> 33;
+}
+
+// Lines of every kind of token, with multibyte characters and CRLF line ends. With [long_line],
+// one of them is long enough that the stream's buffer has to grow past its initial 64KB.
+static char* make_text(bool long_line, uint64_t* length) {
+    char* text = malloc(512 * 1024);
+    uint64_t size = 0;
+    for(int i = 0; i < 3000; ++i) {
+        size += sprintf(text + size, "KEY_%d %d -%d.5 'str\xc3\xa9 %d' @ n\xc3\xa4me # c\n", i, i, i, i);
+        if(i % 7 == 0) size += sprintf(text + size, "\r\n\n  \t1e%d\r\n", i % 300);
+        if(long_line && i == 1500) {
+            size += sprintf(text + size, "long");
+            for(int j = 0; j < 100000; ++j) text[size++] = 'a' + j % 26;
+            size += sprintf(text + size, " 42\n");
+        }
+    }
+    size += sprintf(text + size, "no_newline_at_the_end 12");
+    *length = size;
+    return text;
+}
+
+static void expected_run(const char* text, uint64_t length, test_run* run) {
+    parsec_token* tokens = malloc((length + 1) * sizeof(parsec_token));
+    parsec parser;
+    parsec_init(&parser, text, length, '#');
+    run->result = parsec_lex(&parser, tokens, length + 1);
+    run->count = parser.next_token - (run->result == PARSEC_INVALID ? 1 : 0);
+    run->head = parser.head - text;
+    run->tokens = malloc((run->count + 1) * sizeof(test_token));
+    for(uint64_t i = 0; i < run->count; ++i) {
+        run->tokens[i] = (test_token){ tokens[i].kind, tokens[i].start - text, tokens[i].length };
+    }
+    free(tokens);
+}
+
+static uint64_t stream_offset(const parsec_stream* stream, uint64_t fed, const char* ptr) {
+    return stream->buffer ? fed - stream->size + (ptr - stream->buffer) : fed;
+}
+
+// Keeps the tokens of the last call on [stream], which are lost on the next one.
+static void collect(test_run* run, const parsec_stream* stream, uint64_t fed,
+                    const parsec_token* tokens, uint64_t count) {
+    for(uint64_t i = 0; i < count; ++i) {
+        run->tokens[run->count++] = (test_token){
+            tokens[i].kind, stream_offset(stream, fed, tokens[i].start), tokens[i].length
+        };
+    }
+}
+
+// Feeds [text] in chunks of [chunk] bytes (random sizes up to 4KB if [chunk] is 0), into an array
+// of [capacity] tokens, resuming every time it fills up.
+static void stream_run(const char* text, uint64_t length, uint64_t chunk, uint64_t capacity,
+                       test_run* run) {
+    parsec_token* tokens = malloc(capacity * sizeof(parsec_token));
+    run->tokens = malloc((length + 1) * sizeof(test_token));
+    run->count = 0;
+    run->result = PARSEC_SUCCESS;
+    
+    parsec_stream stream;
+    parsec_stream_init(&stream, '#');
+    uint64_t fed = 0;
+    bool finished = false;
+    while(!finished) {
+        uint64_t size = chunk ? chunk : 1 + next_random() % 4096;
+        if(size > length - fed) size = length - fed;
+        parsec_result result = fed < length
+            ? parsec_feed(&stream, text + fed, size, tokens, capacity)
+            : parsec_finish(&stream, tokens, capacity);
+        finished = fed == length;
+        fed += size;
+        
+        while(result == PARSEC_NOMEM) {
+            collect(run, &stream, fed, tokens, stream.parser.next_token);
+            result = finished ? parsec_finish(&stream, tokens, capacity)
+                              : parsec_feed(&stream, NULL, 0, tokens, capacity);
+        }
+        if(result == PARSEC_INVALID) {
+            collect(run, &stream, fed, tokens, stream.parser.next_token - 1);
+            run->result = PARSEC_INVALID;
+            run->head = stream_offset(&stream, fed, stream.parser.head);
+            break;
+        }
+        CHECK(result >= 0);
+        collect(run, &stream, fed, tokens, result);
+        run->head = stream_offset(&stream, fed, stream.parser.head);
+    }
+    if(run->result != PARSEC_INVALID) run->result = (int)run->count;
+    parsec_stream_deinit(&stream);
+    free(tokens);
+}
+
+static bool same_runs(const test_run* a, const test_run* b) {
+    if(a->result != b->result || a->count != b->count || a->head != b->head) return false;
+    for(uint64_t i = 0; i < a->count; ++i) {
+        const test_token* x = &a->tokens[i];
+        const test_token* y = &b->tokens[i];
+        if(x->kind != y->kind || x->offset != y->offset || x->length != y->length) return false;
+    }
+    return true;
+}
+
+static void compare(const char* text, uint64_t length) {
+    const uint64_t chunks[] = { 1, 7, 4096, 65536 + 13, length, 0 };
+    const uint64_t capacities[] = { 1, 3, 1000, length + 1 };
+    test_run expected;
+    expected_run(text, length, &expected);
+    
+    for(size_t c = 0; c < sizeof(chunks) / sizeof(chunks[0]); ++c) {
+        for(size_t k = 0; k < sizeof(capacities) / sizeof(capacities[0]); ++k) {
+            // Byte by byte into a single token is slow, and covered well enough by larger arrays.
+            if(chunks[c] == 1 && capacities[k] == 1) continue;
+            test_run run;
+            stream_run(text, length, chunks[c], capacities[k], &run);
+            bool same = same_runs(&expected, &run);
+            if(!same) {
+                fprintf(stderr, "chunks of %llu, %llu tokens: result %d/%d, %llu/%llu tokens, "
+                        "head %llu/%llu\n", (unsigned long long)chunks[c],
+                        (unsigned long long)capacities[k], expected.result, run.result,
+                        (unsigned long long)expected.count, (unsigned long long)run.count,
+                        (unsigned long long)expected.head, (unsigned long long)run.head);
+            }
+            CHECK(same);
+            free(run.tokens);
+        }
+    }
+    free(expected.tokens);
+}
+
+int main(void) {
+    compare("", 0);
+    compare("\n\n\n", 3);
+    for(int long_line = 0; long_line < 2; ++long_line) {
+        uint64_t length;
+        char* text = make_text(long_line, &length);
+        compare(text, length);
+        
+        // An invalid token stops the stream where it stops parsec_lex.
+        char* bad = strstr(text, "KEY_2345 ");
+        memcpy(bad, "KEY_2345 1.e5", 13);
+        compare(text, length);
+        free(text);
+    }
+    TEST_END();
+}
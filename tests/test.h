@@ -0,0 +1,31 @@
+//===--------------------------------------------------------------------------------------------===
+// test.h - Minimal helpers shared by the ParseC tests
+// This source is part of ParseC
+//
+// Copyright (c) 2018 Amy Parent <amy@amyparent.com>
+// Licensed under the MIT License
+// =^•.•^=
+//===--------------------------------------------------------------------------------------------===
+#ifndef _PARSEC_TEST_H_
+#define _PARSEC_TEST_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+
+// Each test is a plain executable run by ctest: failed checks are reported as they happen, and
+// TEST_END turns them into the exit status.
+static int test_failures = 0;
+
+#define CHECK(cond) do {                                                                            \
+        if(!(cond)) {                                                                               \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond);                \
+            test_failures += 1;                                                                     \
+        }                                                                                           \
+    } while(0)
+
+#define TEST_END() do {                                                                             \
+        if(test_failures) fprintf(stderr, "%d check(s) failed\n", test_failures);                   \
+        return test_failures ? EXIT_FAILURE : EXIT_SUCCESS;                                         \
+    } while(0)
+
+#endif /* _PARSEC_TEST_H_ */
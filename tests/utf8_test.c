@@ -0,0 +1,154 @@
+//===--------------------------------------------------------------------------------------------===
+// utf8_test.c - parsec_utf8_valid against the scalar checker and a reference decoder
+// This source is part of ParseC
+//
+// Copyright (c) 2018 Amy Parent <amy@amyparent.com>
+// Licensed under the MIT License
+// =^•.•^=
+//===--------------------------------------------------------------------------------------------===
+#include "test.h"
+#include "utf8.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <parsec/parsec.h>
+
+// parsec_utf8_valid goes through the best kernel the CPU has (AVX2 on most x86 machines), which
+// works on 64-byte blocks and checks the tail from a padded copy. Sequences are placed on both
+// sides of block boundaries, and at the very end of the input, where a cut-off one must still
+// be caught.
+
+static const char* const valid[] = {
+    "\xc2\x80", "\xc3\xa9", "\xdf\xbf",
+    "\xe0\xa0\x80", "\xe2\x82\xac", "\xed\x9f\xbf", "\xee\x80\x80", "\xef\xbf\xbf",
+    "\xf0\x90\x80\x80", "\xf0\x9f\x98\x80", "\xf4\x8f\xbf\xbf",
+};
+
+static const char* const invalid[] = {
+    "\x80", "\xbf", "\xfe", "\xff", "\xf5\x80\x80\x80",             // not a lead byte
+    "\xc0\x80", "\xc1\xbf", "\xe0\x9f\xbf", "\xf0\x8f\xbf\xbf",     // overlong
+    "\xed\xa0\x80", "\xed\xbf\xbf",                                 // surrogates
+    "\xf4\x90\x80\x80",                                             // past U+10FFFF
+    "\xc3", "\xe2\x82", "\xf0\x9f\x98",                             // cut short
+    "\xc3\x28", "\xe2\x28\xa1", "\xf0\x9f\x28\x80",                 // bad continuation
+    "\xc3\xa9\xa9",                                                 // one continuation too many
+};
+
+#define COUNT(array) (sizeof(array) / sizeof((array)[0]))
+
+// Decodes every sequence in full, and checks the codepoint against the ranges UTF-8 allows.
+static bool reference_valid(const uint8_t* data, uint64_t length) {
+    static const uint32_t minimum[] = { 0, 0, 0x80, 0x800, 0x10000 };
+    for(uint64_t i = 0; i < length;) {
+        uint8_t lead = data[i];
+        int size;
+        uint32_t point;
+        if(lead < 0x80) {
+            i += 1;
+            continue;
+        }
+        if((lead & 0xe0) == 0xc0)       { size = 2; point = lead & 0x1f; }
+        else if((lead & 0xf0) == 0xe0)  { size = 3; point = lead & 0x0f; }
+        else if((lead & 0xf8) == 0xf0)  { size = 4; point = lead & 0x07; }
+        else return false;
+        if(length - i < (uint64_t)size) return false;
+        for(int j = 1; j < size; ++j) {
+            if((data[i + j] & 0xc0) != 0x80) return false;
+            point = (point << 6) | (data[i + j] & 0x3f);
+        }
+        if(point < minimum[size] || point > 0x10ffff) return false;
+        if(point >= 0xd800 && point <= 0xdfff) return false;
+        i += size;
+    }
+    return true;
+}
+
+// What the scalar kernel does, with the same sequence checker.
+static bool scalar_valid(const char* data, uint64_t length) {
+    for(uint64_t i = 0; i < length;) {
+        int8_t size = utf8_checkSequence(data + i, length - i);
+        if(size < 0) return false;
+        i += size;
+    }
+    return true;
+}
+
+// Copies [data] to a buffer of its own, so that reading past its end would be caught by tools.
+static bool check(const char* data, uint64_t length) {
+    char* copy = calloc(length ? length : 1, 1);
+    memcpy(copy, data, length);
+    bool expected = reference_valid((const uint8_t*)copy, length);
+    bool same = parsec_utf8_valid(copy, length) == expected && scalar_valid(copy, length) == expected;
+    free(copy);
+    return same;
+}
+
+// Every sequence, at every offset around the first two block boundaries, in ASCII and in
+// multibyte text, with nothing or some text after it.
+static void test_placement(void) {
+    char buffer[256];
+    const char* backgrounds[] = { "a", "\xc3\xa9", "\xe2\x82\xac" };
+    const uint64_t tails[] = { 0, 1, 7, 64 };
+    
+    for(size_t b = 0; b < COUNT(backgrounds); ++b) {
+        uint64_t unit = strlen(backgrounds[b]);
+        for(uint64_t at = 0; at < 140; at += unit) {
+            for(size_t t = 0; t < COUNT(tails); ++t) {
+                for(size_t i = 0; i < COUNT(valid) + COUNT(invalid); ++i) {
+                    const char* sequence = i < COUNT(valid) ? valid[i] : invalid[i - COUNT(valid)];
+                    uint64_t size = strlen(sequence);
+                    uint64_t length = 0;
+                    while(length < at) length += sprintf(buffer + length, "%s", backgrounds[b]);
+                    memcpy(buffer + length, sequence, size);
+                    length += size;
+                    for(uint64_t end = length + tails[t]; length < end;) {
+                        length += sprintf(buffer + length, "%s", backgrounds[b]);
+                    }
+                    
+                    bool ok = check(buffer, length);
+                    if(!ok) fprintf(stderr, "sequence %zu at %llu\n", i, (unsigned long long)at);
+                    CHECK(ok);
+                    CHECK(reference_valid((const uint8_t*)buffer, length) == (i < COUNT(valid)));
+                }
+            }
+        }
+    }
+}
+
+// Random text made of valid characters, with an invalid sequence or a random byte thrown in now
+// and then. Long inputs go past the points where the vector kernel stops to look at its errors.
+static void test_random(void) {
+    uint64_t seed = 0x9e3779b97f4a7c15ull;
+    char* buffer = malloc(16384 + 16);
+    
+    for(int round = 0; round < 20000; ++round) {
+        seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+        uint64_t target = (seed >> 33) % (round % 100 ? 300 : 16384);
+        uint64_t length = 0;
+        while(length < target) {
+            seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+            uint32_t pick = (uint32_t)(seed >> 40) % 1000;
+            const char* piece = NULL;
+            if(pick < 700) buffer[length++] = 'a' + pick % 26;
+            else if(pick < 996) piece = valid[pick % COUNT(valid)];
+            else if(pick < 999) piece = invalid[pick % COUNT(invalid)];
+            else buffer[length++] = (char)(seed >> 56);
+            if(piece) {
+                memcpy(buffer + length, piece, strlen(piece));
+                length += strlen(piece);
+            }
+        }
+        bool ok = check(buffer, length);
+        if(!ok) fprintf(stderr, "round %d, %llu bytes\n", round, (unsigned long long)length);
+        CHECK(ok);
+    }
+    free(buffer);
+}
+
+int main(void) {
+    CHECK(check("", 0));
+    test_placement();
+    test_random();
+    TEST_END();
+}
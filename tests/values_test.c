@@ -0,0 +1,119 @@
+//===--------------------------------------------------------------------------------------------===
+// values_test.c - Numbers converted while they're lexed, against strtoll and strtod
+// This source is part of ParseC
+//
+// Copyright (c) 2018 Amy Parent <amy@amyparent.com>
+// Licensed under the MIT License
+// =^•.•^=
+//===--------------------------------------------------------------------------------------------===
+#include "test.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <parsec/parsec.h>
+
+#define TEST_NUMBERS    20000
+
+// Numbers on both sides of the int64_t limits, past the range of doubles, subnormals, more digits
+// than fit in a uint64_t, and 'd' exponents.
+static const char* const fixed[] = {
+    "0", "-0", "+7", "00012", "-0.0", "0.1", ".5", "-.5",
+    "9223372036854775807", "9223372036854775808", "-9223372036854775808", "-9223372036854775809",
+    "123456789012345678901234567890", "-000000000000000000000000000001",
+    "1e400", "-1e400", "1e-400", "4.9e-324", "2.4703282292062328e-324", "2.2250738585072014e-308",
+    "1.7976931348623157e308", "1.7976931348623159e308", "9007199254740993", "9007199254740993.0",
+    "0.000000000000000000000000000000000000000000000001", "1d10", "2.5D-3", "1e+0", "7E00001",
+};
+
+static uint64_t seed = 0xda942042e4dd58b5ull;
+
+static uint64_t next_random(void) {
+    seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+    return seed >> 33;
+}
+
+// Writes a random number to [out]: integers of up to 25 digits, or decimals with up to 40 digits
+// of mantissa and exponents up to +/-350.
+static int random_number(char* out) {
+    int size = 0;
+    uint64_t shape = next_random();
+    if(shape & 1) out[size++] = shape & 2 ? '-' : '+';
+    int digits = 1 + (int)(next_random() % (shape & 4 ? 40 : 25));
+    int point = shape & 4 ? (int)(next_random() % (digits + 1)) : -1;
+    for(int i = 0; i < digits; ++i) {
+        if(i == point) out[size++] = '.';
+        out[size++] = '0' + next_random() % 10;
+    }
+    if(point == digits) out[size++] = '0';
+    if((shape & 12) == 12) size += sprintf(out + size, "%c%d", "eEdD"[shape >> 4 & 3],
+                                           (int)(next_random() % 701) - 350);
+    return size;
+}
+
+// What a number should convert to, with the C library: integers are clamped the way strtoll
+// clamps them, and 'd' exponents are 'e' exponents.
+static bool check_value(const parsec_token* token, const parsec_value* value) {
+    char text[128];
+    memcpy(text, token->start, token->length);
+    text[token->length] = '\0';
+    if(token->kind == PARSEC_TOKEN_INT) return value->integer == strtoll(text, NULL, 10);
+    
+    for(char* c = text; *c; ++c) {
+        if(*c == 'd' || *c == 'D') *c = 'e';
+    }
+    double expected = strtod(text, NULL);
+    return !memcmp(&expected, &value->real, sizeof(double));
+}
+
+int main(void) {
+    uint64_t fixed_count = sizeof(fixed) / sizeof(fixed[0]);
+    char* source = malloc(64 * (TEST_NUMBERS + fixed_count));
+    uint64_t length = 0;
+    for(uint64_t i = 0; i < fixed_count; ++i) length += sprintf(source + length, "%s ", fixed[i]);
+    for(int i = 0; i < TEST_NUMBERS; ++i) {
+        length += random_number(source + length);
+        // Other tokens in between, whose values must be left alone.
+        length += sprintf(source + length, i % 10 ? " " : " key 'str' @ # comment\n");
+    }
+    
+    uint64_t capacity = TEST_NUMBERS * 2 + fixed_count + 1;
+    parsec_token* tokens = malloc(capacity * sizeof(parsec_token));
+    parsec_value* values = malloc(capacity * sizeof(parsec_value));
+    for(uint64_t i = 0; i < capacity; ++i) values[i].integer = 0x5a5a5a5a;
+    
+    parsec parser;
+    parsec_init(&parser, source, length, '#');
+    parsec_result count = parsec_lex_values(&parser, tokens, values, capacity);
+    CHECK(count > TEST_NUMBERS);
+    
+    // The same tokens as parsec_lex, and parsec_next_value agrees with parsec_lex_values.
+    parsec_token* plain = malloc(capacity * sizeof(parsec_token));
+    parsec_init(&parser, source, length, '#');
+    CHECK(parsec_lex(&parser, plain, capacity) == count);
+    parsec_init(&parser, source, length, '#');
+    
+    int failures = 0;
+    for(parsec_result i = 0; i < count; ++i) {
+        const parsec_token* token = &tokens[i];
+        CHECK(token->kind == plain[i].kind && token->start == plain[i].start
+              && token->length == plain[i].length);
+        
+        parsec_token next;
+        parsec_value value;
+        CHECK(parsec_next_value(&parser, &next, &value) == 1);
+        bool number = token->kind == PARSEC_TOKEN_INT || token->kind == PARSEC_TOKEN_FLOAT;
+        bool ok = number ? check_value(token, &values[i]) : values[i].integer == 0x5a5a5a5a;
+        ok = ok && (!number || !memcmp(&value, &values[i], sizeof(value)));
+        if(!ok && failures++ < 10) {
+            fprintf(stderr, "'%.*s': %lld / %.17g\n", (int)token->length, token->start,
+                    (long long)values[i].integer, values[i].real);
+        }
+        CHECK(ok);
+    }
+    free(plain);
+    free(values);
+    free(tokens);
+    free(source);
+    TEST_END();
+}
@@ -0,0 +1,242 @@
+//===--------------------------------------------------------------------------------------------===
+// numgen.c - Generates the number lexer's transition tables
+// This source is part of ParseC
+//
+// Copyright (c) 2018 Amy Parent <amy@amyparent.com>
+// Licensed under the MIT License
+// =^•.•^=
+//===--------------------------------------------------------------------------------------------===
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Usage:
+//      parsec_numgen OUTPUT [CXX_OUTPUT]
+//
+// Numbers are lexed by a DFA over byte classes. The transitions are the same for every dialect;
+// what a dialect changes is which bytes fall into which class. Both tables are written to OUTPUT
+// as C arrays, along with the state and class enums parsec.c uses to read them.
+//
+// parsec.hpp builds its class tables from each dialect type, but reads the same transitions: when
+// CXX_OUTPUT is given, they are written there too, as a constexpr array in parsecpp::detail.
+
+// MARK: - Dialects
+
+// Each dialect's class table is indexed by its parsec_dialect name. NUL is always a terminator:
+// it's what the lexer reads past the end of the input.
+typedef struct {
+    const char* name;
+    const char* exponents;
+    const char* terminators;
+} numgen_dialect;
+
+static const numgen_dialect dialects[] = {
+    { "PARSEC_DIALECT_DEFAULT",  "eEdD",  " \t\v\f\r\n" },
+    { "PARSEC_DIALECT_C",        "eE",    " \t\v\f\r\n" },
+};
+
+// MARK: - Classes and states
+
+static const char* classes[] = {
+    "NUMCLASS_OTHER",
+    "NUMCLASS_DIGIT",
+    "NUMCLASS_SIGN",
+    "NUMCLASS_POINT",
+    "NUMCLASS_EXPONENT",
+    "NUMCLASS_TERMINATOR",
+};
+
+static const char* cxx_classes[] = {
+    "NUM_OTHER",
+    "NUM_DIGIT",
+    "NUM_SIGN",
+    "NUM_POINT",
+    "NUM_EXPONENT",
+    "NUM_TERMINATOR",
+};
+
+enum { OTHER, DIGIT, SIGN, POINT, EXPONENT, TERMINATOR, CLASS_COUNT };
+
+// Every state from STATE_INT on is final: the number either ended there, or can't be a number.
+static const char* states[] = {
+    "STATE_START",
+    "STATE_SIGN",
+    "STATE_INTEGRAL",
+    "STATE_POINT",
+    "STATE_DECIMAL",
+    "STATE_E",
+    "STATE_ES",
+    "STATE_EXPONENT",
+    "STATE_INT",
+    "STATE_FLOAT",
+    "STATE_INVALID",
+};
+
+static const char* cxx_states[] = {
+    "NUM_START",
+    "NUM_SIGNED",
+    "NUM_INTEGRAL",
+    "NUM_POINTED",
+    "NUM_DECIMAL",
+    "NUM_E",
+    "NUM_ES",
+    "NUM_EXPONENTIAL",
+    "NUM_INT",
+    "NUM_FLOAT",
+    "NUM_INVALID",
+};
+
+enum {
+    START, SIGNED, INTEGRAL, POINTED, DECIMAL, E, ES, EXPONENTIAL, INT, FLOAT, INVALID, STATE_COUNT
+};
+
+typedef struct {
+    int from;
+    int on;
+    int to;
+} numgen_rule;
+
+// Anything that isn't listed goes to STATE_INVALID.
+static const numgen_rule rules[] = {
+    { START,        SIGN,       SIGNED },
+    { START,        POINT,      POINTED },
+    { START,        DIGIT,      INTEGRAL },
+    
+    { SIGNED,       DIGIT,      INTEGRAL },
+    { SIGNED,       POINT,      POINTED },
+    
+    { INTEGRAL,     DIGIT,      INTEGRAL },
+    { INTEGRAL,     POINT,      POINTED },
+    { INTEGRAL,     EXPONENT,   E },
+    { INTEGRAL,     TERMINATOR, INT },
+    
+    { POINTED,      DIGIT,      DECIMAL },
+    
+    { DECIMAL,      DIGIT,      DECIMAL },
+    { DECIMAL,      EXPONENT,   E },
+    { DECIMAL,      TERMINATOR, FLOAT },
+    
+    { E,            SIGN,       ES },
+    { E,            DIGIT,      EXPONENTIAL },
+    
+    { ES,           DIGIT,      EXPONENTIAL },
+    
+    { EXPONENTIAL,  DIGIT,      EXPONENTIAL },
+    { EXPONENTIAL,  TERMINATOR, FLOAT },
+};
+
+#define COUNT(array) (sizeof(array) / sizeof((array)[0]))
+
+// MARK: - Output
+
+static void write_enum(FILE* out, const char* name, const char** values, int count) {
+    fprintf(out, "typedef enum {\n");
+    for(int i = 0; i < count; ++i) fprintf(out, "    %s,\n", values[i]);
+    fprintf(out, "} %s;\n\n", name);
+}
+
+static void write_classes(FILE* out, const numgen_dialect* dialect) {
+    unsigned char table[256] = { 0 };
+    for(int c = '0'; c <= '9'; ++c) table[c] = DIGIT;
+    table['+'] = table['-'] = SIGN;
+    table['.'] = POINT;
+    for(const char* c = dialect->exponents; *c; ++c) table[(unsigned char)*c] = EXPONENT;
+    for(const char* c = dialect->terminators; *c; ++c) table[(unsigned char)*c] = TERMINATOR;
+    table[0] = TERMINATOR;
+    
+    fprintf(out, "    [%s] = {", dialect->name);
+    for(int i = 0; i < 256; ++i) fprintf(out, "%s%d,", i % 32 ? " " : "\n        ", table[i]);
+    fprintf(out, "\n    },\n");
+}
+
+static void write_cxx_enum(FILE* out, const char* name, const char** values, int count,
+                           const char* last) {
+    fprintf(out, "enum %s : std::uint8_t {\n", name);
+    for(int i = 0; i < count; ++i) fprintf(out, "    %s,\n", values[i]);
+    fprintf(out, "    %s\n};\n\n", last);
+}
+
+static int write_c(const char* path, int transitions[STATE_COUNT][CLASS_COUNT]) {
+    FILE* out = fopen(path, "w");
+    if(!out) {
+        perror(path);
+        return 1;
+    }
+    
+    fprintf(out, "// Generated by parsec_numgen (tools/numgen.c). Do not edit.\n");
+    fprintf(out, "#ifndef _PARSEC_NUMBER_DFA_\n#define _PARSEC_NUMBER_DFA_\n\n");
+    fprintf(out, "#include <stdint.h>\n#include <parsec/parsec.h>\n\n");
+    write_enum(out, "private_numclass", classes, CLASS_COUNT);
+    write_enum(out, "private_numstate", states, STATE_COUNT);
+    fprintf(out, "#define STATE_FINAL %s\n", states[INT]);
+    fprintf(out, "#define NUMBER_DIALECT_COUNT %u\n\n", (unsigned)COUNT(dialects));
+    
+    fprintf(out, "static const uint8_t number_classes[NUMBER_DIALECT_COUNT][256] = {\n");
+    for(unsigned i = 0; i < COUNT(dialects); ++i) write_classes(out, &dialects[i]);
+    fprintf(out, "};\n\n");
+    
+    fprintf(out, "static const uint8_t number_transitions[%d][%d] = {\n", STATE_COUNT, CLASS_COUNT);
+    for(int s = 0; s < STATE_COUNT; ++s) {
+        fprintf(out, "    [%s] = {", states[s]);
+        for(int c = 0; c < CLASS_COUNT; ++c) fprintf(out, " %s,", states[transitions[s][c]]);
+        fprintf(out, " },\n");
+    }
+    fprintf(out, "};\n\n#endif /* _PARSEC_NUMBER_DFA_ */\n");
+    
+    if(fclose(out) != 0) {
+        perror(path);
+        return 1;
+    }
+    return 0;
+}
+
+// C++ has no designated array initialisers, so rows are written in order, and named in comments.
+static int write_cxx(const char* path, int transitions[STATE_COUNT][CLASS_COUNT]) {
+    FILE* out = fopen(path, "w");
+    if(!out) {
+        perror(path);
+        return 1;
+    }
+    
+    fprintf(out, "// Generated by parsec_numgen (tools/numgen.c). Do not edit.\n");
+    fprintf(out, "#ifndef _PARSEC_NUMBER_DFA_HPP_\n#define _PARSEC_NUMBER_DFA_HPP_\n\n");
+    fprintf(out, "#include <cstdint>\n\nnamespace parsecpp {\nnamespace detail {\n\n");
+    write_cxx_enum(out, "number_class", cxx_classes, CLASS_COUNT, "NUM_CLASS_COUNT");
+    write_cxx_enum(out, "number_state", cxx_states, STATE_COUNT, "NUM_STATE_COUNT");
+    
+    fprintf(out, "constexpr std::uint8_t number_transitions[NUM_STATE_COUNT][NUM_CLASS_COUNT] = {\n");
+    for(int s = 0; s < STATE_COUNT; ++s) {
+        fprintf(out, "    {");
+        for(int c = 0; c < CLASS_COUNT; ++c) fprintf(out, " %s,", cxx_states[transitions[s][c]]);
+        fprintf(out, " },  // %s\n", cxx_states[s]);
+    }
+    fprintf(out, "};\n\n} // namespace detail\n} // namespace parsecpp\n\n");
+    fprintf(out, "#endif /* _PARSEC_NUMBER_DFA_HPP_ */\n");
+    
+    if(fclose(out) != 0) {
+        perror(path);
+        return 1;
+    }
+    return 0;
+}
+
+int main(int argc, const char** argv) {
+    if(argc != 2 && argc != 3) {
+        fprintf(stderr, "usage: parsec_numgen OUTPUT [CXX_OUTPUT]\n");
+        return 1;
+    }
+    
+    int transitions[STATE_COUNT][CLASS_COUNT];
+    for(int s = 0; s < STATE_COUNT; ++s) {
+        for(int c = 0; c < CLASS_COUNT; ++c) transitions[s][c] = INVALID;
+    }
+    for(unsigned i = 0; i < COUNT(rules); ++i) transitions[rules[i].from][rules[i].on] = rules[i].to;
+    // Final states stay put, so a stray lookup can't leave them.
+    for(int s = INT; s < STATE_COUNT; ++s) {
+        for(int c = 0; c < CLASS_COUNT; ++c) transitions[s][c] = s;
+    }
+    
+    if(write_c(argv[1], transitions)) return 1;
+    if(argc == 3 && write_cxx(argv[2], transitions)) return 1;
+    return 0;
+}